@@ -17,18 +17,14 @@ end;
 
 function Cirno_Nonspell1(id)
 	local shoot_radial_bullets = function()
-		return ShootRadial(17, 360 / 17, function()
-			return Shoot{GetX(id), GetY(id), 3.5, TargetDir(id), 0, BULLET_OUTLINE, 6};
-		end);
+		return ShootArc(GetX(id), GetY(id), 3.5, TargetDir(id), 0, BULLET_OUTLINE, 6, 17, 360 / 17);
 	end;
 
 	while (true) do
 		SetSpr(id, sprCirnoFlap);
 		for i = 1, 3 do
 			for i = 0, 5 do
-				ShootRadial(7 - i, 5, function()
-					return Shoot{GetX(id), GetY(id), lerp(4, 7.5, i / 5), TargetDir(id), 0, BULLET_PELLET, 6};
-				end);
+				ShootArc(GetX(id), GetY(id), lerp(4, 7.5, i / 5), TargetDir(id), 0, BULLET_PELLET, 6, 7 - i, 5);
 			end
 
 			wait(60);
@@ -46,13 +42,11 @@ function Cirno_Nonspell1(id)
 
 			wait(15);
 
-			ShootRadial(17, 360 / 17, function()
-				return Shoot{GetX(id), GetY(id), 4.5, TargetDir(id), -0.08, BULLET_PELLET, 15, function(id)
-					while (GetSpd(id) > 0) do wait(1); end
-					SetAcc(id, 0);
-					SetSpd(id, 5);
-					SetDir(id, TargetDir(id));
-				end};
+			ShootArc(GetX(id), GetY(id), 4.5, TargetDir(id), -0.08, BULLET_PELLET, 15, 17, 360 / 17, 0, function(id)
+				while (GetSpd(id) > 0) do wait(1); end
+				SetAcc(id, 0);
+				SetSpd(id, 5);
+				SetDir(id, TargetDir(id));
 			end);
 
 			wait(15);
@@ -102,9 +96,7 @@ function Cirno_IcicleFall(id)
 			end
 
 			if (i % 3 == 2) then
-				ShootRadial(5, 20, function()
-					return Shoot{GetX(id), GetY(id), 2, TargetDir(id), 0, BULLET_FILLED, 13};
-				end);
+				ShootArc(GetX(id), GetY(id), 2, TargetDir(id), 0, BULLET_FILLED, 13, 5, 20);
 			end
 
 			wait(20);
@@ -119,13 +111,9 @@ function Cirno_Nonspell2(id)
 
 		for i = 1, 16 do
 			if (i % 2 == 0) then
-				ShootRadial(8, 360 / 8, function()
-					return Shoot{GetX(id), GetY(id), 4, TargetDir(id) + 360 / 8 / 2, 0, BULLET_OUTLINE, 6};
-				end)
+				ShootArc(GetX(id), GetY(id), 4, TargetDir(id) + 360 / 8 / 2, 0, BULLET_OUTLINE, 6, 8, 360 / 8)
 			else
-				ShootRadial(8, 360 / 8, function()
-					return Shoot{GetX(id), GetY(id), 2, TargetDir(id), 0, BULLET_SMALL, 6};
-				end)
+				ShootArc(GetX(id), GetY(id), 2, TargetDir(id), 0, BULLET_SMALL, 6, 8, 360 / 8)
 			end
 
 			wait(10);
@@ -171,9 +159,7 @@ function Cirno_PerfectFreeze(id)
 
 		for i = 1, 5 do
 			for i = 0, 4 do
-				ShootRadial(4, 30, function()
-					return Shoot{GetX(id), GetY(id), lerp(2, 6, i / 4), TargetDir(id), 0, BULLET_OUTLINE, 6};
-				end)
+				ShootArc(GetX(id), GetY(id), lerp(2, 6, i / 4), TargetDir(id), 0, BULLET_OUTLINE, 6, 4, 30)
 			end
 
 			wait(10);
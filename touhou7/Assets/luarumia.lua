@@ -10,9 +10,7 @@ function Rumia_Nonspell1(id)
 		wait(10)
 
 		for j = 1, 7 do
-			Radial(10, 0, function(i)
-				return Shoot{GetX(id), GetY(id), lerp(1.5,5,i/9), TargetDir(id), 0, BULLET_FILLED, 1+j%2}
-			end)
+			ShootStack(GetX(id), GetY(id), 1.5, TargetDir(id), 0, BULLET_FILLED, 1+j%2, 10, (5-1.5)/9)
 
 			wait(10)
 		end
@@ -24,18 +22,14 @@ function Rumia_Nonspell1(id)
 		wait(60)
 
 		-- red rice
-		Radial(16, 0, function(j)
-			return Radial(3, 4, function()
-				return Shoot{GetX(id), GetY(id), lerp(1.5,5,j/15), TargetDir(id), 0, BULLET_RICE, 1}
-			end)
-		end)
+		for j = 0, 15 do
+			ShootArc(GetX(id), GetY(id), lerp(1.5,5,j/15), TargetDir(id), 0, BULLET_RICE, 1, 3, 4)
+		end
 
 		wait(60)
 
 		-- blue
-		Radial(16, 360/16, function()
-			return Shoot{GetX(id), GetY(id), 2.5, TargetDir(id), 0, BULLET_OUTLINE, 6}
-		end)
+		ShootArc(GetX(id), GetY(id), 2.5, TargetDir(id), 0, BULLET_OUTLINE, 6, 16, 360/16)
 
 		wait(200)
 	end
@@ -71,11 +65,9 @@ function Rumia_Nonspell2(id)
 
 		wait(10)
 
-		Radial(8, 0, function(j)
-			return Radial(2, 5, function()
-				return Shoot{GetX(id), GetY(id), lerp(1.75, 3.25, j/7), TargetDir(id), 0, BULLET_OUTLINE, 10}
-			end)
-		end)
+		for j = 0, 7 do
+			ShootArc(GetX(id), GetY(id), lerp(1.75, 3.25, j/7), TargetDir(id), 0, BULLET_OUTLINE, 10, 2, 5)
+		end
 
 		for i = 1, 6 do
 			SLazer{GetX(id), GetY(id), TargetDir(id), seconds(2), seconds(1), 10, 8}
@@ -101,13 +93,9 @@ function Rumia_Nonspell2(id)
 		wait(seconds(1))
 
 		for i = 0, 2 do
-			Radial(8, lerp(10, 20, i/2), function()
-				return Shoot{GetX(id), GetY(id), 3.25, TargetDir(id), 0, BULLET_RICE, 13}
-			end)
+			ShootArc(GetX(id), GetY(id), 3.25, TargetDir(id), 0, BULLET_RICE, 13, 8, lerp(10, 20, i/2))
 
-			Radial(9, lerp(10, 20, i/2), function()
-				return Shoot{GetX(id), GetY(id), 2, TargetDir(id), 0, BULLET_RICE, 13}
-			end)
+			ShootArc(GetX(id), GetY(id), 2, TargetDir(id), 0, BULLET_RICE, 13, 9, lerp(10, 20, i/2))
 
 			wait(40)
 		end
@@ -118,11 +106,11 @@ function Rumia_Nonspell2(id)
 
 		wait(seconds(1))
 
-		Radial(39, 360/39, function() return Shoot{GetX(id), GetY(id), 2, 0, 0, BULLET_RICE, 0} end)
+		ShootArc(GetX(id), GetY(id), 2, 0, 0, BULLET_RICE, 0, 39, 360/39)
 		wait(40)
-		Radial(38, 360/38, function() return Shoot{GetX(id), GetY(id), 4, 0, 0, BULLET_SMALL, 0} end)
+		ShootArc(GetX(id), GetY(id), 4, 0, 0, BULLET_SMALL, 0, 38, 360/38)
 		wait(40)
-		Radial(39, 360/39, function() return Shoot{GetX(id), GetY(id), 2, 0, 0, BULLET_RICE, 0} end)
+		ShootArc(GetX(id), GetY(id), 2, 0, 0, BULLET_RICE, 0, 39, 360/39)
 		wait(40)
 
 		wait(120)
@@ -155,9 +155,7 @@ function Daiyousei_Nonspell1(id)
 		end
 
 		for i = 1, 20 do
-			ShootRadial(3, 40, function()
-				return Shoot{GetX(id), GetY(id), 2.25, TargetDir(id), 0, BULLET_PELLET, 6};
-			end);
+			ShootArc(GetX(id), GetY(id), 2.25, TargetDir(id), 0, BULLET_PELLET, 6, 3, 40);
 
 			ShootRadial(3, 40, function()
 				local script = function(id)
@@ -70,6 +70,30 @@ function TestStage_Script(id)
 		wait(120)
 	end
 
+::_BULLET_KILLS_OTHER_BULLETS_FAST::
+	do
+		print "bullet kills other bullets (positional spawn)"
+		local bullets = {}
+		local t=0
+		for i = 1, 1000 do
+			bullets[i] = ShootFast(PLAY_AREA_W/2, PLAY_AREA_H/2, 0.5, random(0,360), 0, BULLET_PELLET, choose(6,10))
+			t=t+0.1
+			if t>=1 then wait(1) t=t-1 end
+		end
+		wait(10)
+		local bullet = ShootFast(PLAY_AREA_W/2, 0, 2, 270, 0, BULLET_BULLET, 0, function(id)
+			local t=0
+			for i = 1, 1000 do
+				Destroy(bullets[i])
+				t=t+0.1
+				if t>=1 then wait(1) t=t-1 end
+			end
+		end)
+		while Exists(bullet) do wait(1) end
+		print "done\n"
+		wait(120)
+	end
+
 
 
 	print "tests ended"
@@ -52,37 +52,12 @@ function range(n)
 	return function() i=i+1 if i<=n then return i end end
 end
 
-function wait(t)
-	while t > 0 do
-		coroutine.yield()
-		t = t - 1
-	end
-end
-
 function print_table(t)
 	for k, v in pairs(t) do
 		print(tostring(k) .. " = " .. tostring(v))
 	end
 end
 
-function ShootRadial(n, dir_diff, f)
-	local res = {}
-	for i = 0, n - 1 do
-		local mul = -(n - 1) / 2 + i
-		local got = f(i)
-		if type(got) == "table" then
-			for b in ivalues(got) do
-				SetDir(b, GetDir(b) + dir_diff * mul)
-				res[#res+1] = b
-			end
-		elseif type(got) == "number" then
-			SetDir(got, GetDir(got) + dir_diff * mul)
-			res[#res+1] = got
-		end
-	end
-	return res
-end
-
 function EntityDir(e1, e2)
 	return point_direction(GetX(e1), GetY(e1), GetX(e2), GetY(e2))
 end
@@ -6,8 +6,10 @@
 #include "cpml.h"
 
 #include <SDL_image.h>
+#include <lua.hpp>
 
 #include <fstream>
+#include <iterator>
 #include <sstream>
 
 namespace th {
@@ -88,8 +90,8 @@ namespace th {
 			if (*ch != ' ') {
 				int frame_index = *ch - font->first;
 				SDL_Rect src;
-				src.x = (frame_index % font->frames_in_row) * font->sep_x;
-				src.y = (frame_index / font->frames_in_row) * font->sep_y;
+				src.x = font->u + (frame_index % font->frames_in_row) * font->sep_x;
+				src.y = font->v + (frame_index / font->frames_in_row) * font->sep_y;
 				src.w = font->width;
 				src.h = font->height;
 				SDL_Rect dest;
@@ -104,34 +106,92 @@ namespace th {
 		}
 	}
 
-	void StopSound(Mix_Chunk* sound) {
-		for (int i = 0; i < MIX_CHANNELS; i++) {
-			if (Mix_Playing(i)) {
-				if (Mix_GetChunk(i) == sound) {
-					Mix_HaltChannel(i);
-				}
+	int MeasureText(GlyphAtlas* atlas, const char* text) {
+		if (!atlas) return 0;
+		if (!text) return 0;
+
+		int w = 0;
+		int line_w = 0;
+		for (const char* ch = text; *ch; ch++) {
+			unsigned char c = (unsigned char)*ch;
+			if (c == '\n') {
+				line_w = 0;
+				continue;
 			}
+			if (c < GlyphAtlas::FIRST || c > GlyphAtlas::LAST) continue;
+			line_w += atlas->glyphs[c - GlyphAtlas::FIRST].advance;
+			w = std::max(w, line_w);
 		}
+		return w;
 	}
 
-	bool SoundPlaying(Mix_Chunk* sound) {
-		for (int i = 0; i < MIX_CHANNELS; i++) {
-			if (Mix_Playing(i)) {
-				if (Mix_GetChunk(i) == sound) {
-					return true;
-				}
-			}
-		}
-		return false;
+	void StopSound(SoundId id) {
+		Game& game = Game::GetInstance();
+		if (game.headless) return;
+		game.assets.HaltSound(id);
 	}
 
-	void PlaySound(const std::string& name) {
+	bool SoundPlaying(SoundId id) {
 		Game& game = Game::GetInstance();
-		Mix_Chunk* sound = game.assets.GetSound(name);
-		StopSound(sound);
-		Mix_PlayChannel(-1, sound, 0);
+		if (game.headless) return false;
+		return game.assets.IsSoundPlaying(id);
 	}
 
+	void PlaySound(SoundId id) {
+		Game& game = Game::GetInstance();
+		if (game.headless) return;
+		game.assets.QueueSound(id);
+	}
+
+	void PlaySound(const char* name) {
+		PlaySound(Game::GetInstance().assets.FindSound(name));
+	}
+
+	static constexpr const char* engine_sprite_names[] = {
+		"<default>",
+		"Hitbox",
+		"Pickup",
+		"Lazer",
+		"Sidebar",
+		"UI_Life",
+		"UI_Bomb",
+		"EnemyLabel",
+		"ReimuCard",
+		"ReimuOrbShot",
+	};
+	static_assert(std::size(engine_sprite_names) == ENGINE_SPRITE_COUNT);
+
+	static constexpr const char* engine_texture_names[] = {
+		"<default>",
+		"Background.png",
+		"Logo.png",
+		"CirnoSpellcardBG.png",
+		"font.png",
+		"MistyLakeTexture.png",
+	};
+	static_assert(std::size(engine_texture_names) == ENGINE_TEXTURE_COUNT);
+
+	static constexpr const char* engine_sound_names[] = {
+		"<none>",
+		"se_pause.wav",
+		"se_cancel.wav",
+		"se_ok.wav",
+		"se_select.wav",
+		"se_extend.wav",
+		"se_powerup.wav",
+		"se_enemy_shoot.wav",
+		"se_lazer.wav",
+		"se_graze.wav",
+		"se_pichuun.wav",
+		"se_item.wav",
+		"se_enemy_hit.wav",
+		"se_enemy_die.wav",
+		"se_boss_die.wav",
+		"se_spellcard.wav",
+		"se_plst00.wav",
+	};
+	static_assert(std::size(engine_sound_names) == ENGINE_SOUND_COUNT);
+
 	template <typename F>
 	static bool ReadTextFile(const std::string& assetsFolder, const std::string& fname, const F& f) {
 		std::ifstream file(assetsFolder + fname);
@@ -153,19 +213,33 @@ namespace th {
 	}
 
 	bool Assets::LoadAssets(SDL_Renderer* renderer) {
+		TH_PROFILE_SCOPE("Assets::LoadAssets");
+
 		bool result = true;
 
 		// default texture & sprite
-		{
+		// headless: sprites keep their metadata but have no texture
+		if (renderer) {
 			SDL_Surface* surface = SDL_CreateRGBSurface(0, 16, 16, 24, 0, 0, 0, 0);
 			SDL_FillRect(surface, nullptr, 0xFFFFFFFF);
 			default_texture = SDL_CreateTextureFromSurface(renderer, surface);
 			SDL_FreeSurface(surface);
-			textures["<default>"] = default_texture;
+		}
 
-			default_sprite = new SpriteData{default_texture, 0, 0, 16, 16, 0, 0, 1, 1, 0.0f, 0};
-			sprites["<default>"] = default_sprite;
+		// the engine's names get the handles the SPR_/TEX_/SND_ constants expect
+		SpriteData default_sprite_data{default_texture, 0, 0, 16, 16, 0, 0, 1, 1, 0.0f, 0};
+		for (const char* name : engine_sprite_names) {
+			sprites.Intern(name, default_sprite_data);
 		}
+		for (const char* name : engine_texture_names) {
+			textures.Intern(name, default_texture);
+		}
+		for (const char* name : engine_sound_names) {
+			sounds.Intern(name, nullptr);
+		}
+		textures.loaded[TEX_DEFAULT] = 1;
+		sprites.loaded[SPR_DEFAULT] = 1;
+		default_sprite = &sprites.items[SPR_DEFAULT];
 
 		// textures
 
@@ -177,7 +251,7 @@ namespace th {
 
 		// sprites
 
-		ReadTextFile(assetsFolder, "AllSprites.txt", [this, renderer, &result](const std::string& line) {
+		ReadTextFile(assetsFolder, "AllSprites.txt", [this, renderer, &result, &default_sprite_data](const std::string& line) {
 			std::istringstream stream(line);
 
 			std::string name;
@@ -203,16 +277,23 @@ namespace th {
 				return;
 			}
 
-			SDL_Texture* texture = GetTexture(spritesheet);
-
-			auto lookup = sprites.find(name);
-			if (lookup == sprites.end()) {
-				SpriteData* sprite = new SpriteData{texture, u, v, width, height, xorigin, yorigin, frame_count, frames_in_row, anim_spd, loop_frame};
+			SDL_Texture* texture = GetTexture(spritesheet.c_str());
 
-				sprites.emplace(name, sprite);
+			int id = sprites.Intern(name, default_sprite_data);
+			if (id < 0) {
+				TH_LOG_ERROR("sprite name %s collides with another one", name.c_str());
+				result = false;
+				return;
+			}
+			if (!sprites.loaded[id]) {
+				sprites.items[id] = {texture, u, v, width, height, xorigin, yorigin, frame_count, frames_in_row, anim_spd, loop_frame};
+				sprites.loaded[id] = 1;
 			}
 		});
 
+		// nothing is added to the array from here on
+		default_sprite = &sprites.items[SPR_DEFAULT];
+
 		// lua scripts
 
 		ReadTextFile(assetsFolder, "AllScripts.txt", [this, &result](const std::string& line) {
@@ -231,13 +312,33 @@ namespace th {
 
 		// gui font (hard coded)
 		{
-			fntMain = new SpriteFont{GetTexture("font.png"), 16, 15, 15, 16, 16, 16};
+			fntMain = new SpriteFont{GetTexture(TEX_FONT), 16, 15, 15, 16, 16, 16};
 		}
 
-		{
+		if (renderer) {
+			if (!BuildSpriteAtlas(renderer)) {
+				result = false;
+			}
+		}
+
+		if (renderer) {
 			std::string fullPath = assetsFolder + "Cirno.ttf";
 
 			fntCirno = TTF_OpenFont(fullPath.c_str(), 18);
+
+			if (fntCirno) {
+				if (!(fntCirnoGlyphs = BuildGlyphAtlas(fntCirno, renderer))) {
+					result = false;
+				}
+			} else {
+				TH_LOG_ERROR("couldn't open font Cirno.ttf: %s", TTF_GetError());
+				result = false;
+			}
+		}
+
+		// there is no audio device in headless mode
+		if (!renderer) {
+			return result;
 		}
 
 		// sounds
@@ -255,65 +356,69 @@ namespace th {
 				return;
 			}
 
-			Mix_Chunk* sound = GetSound(fname);
+			Mix_Chunk* sound = GetSound(FindSound(fname.c_str()));
 			Mix_VolumeChunk(sound, (int)(volume * (float)MIX_MAX_VOLUME));
 		});
 
+		sound_queued.assign(sounds.items.size(), 0);
+		sound_channels.assign(sounds.items.size(), -1);
+		sound_queue.reserve(sounds.items.size());
+
 		return result;
 	}
 
 	void Assets::UnloadAssets() {
-		for (auto it = sounds.begin(); it != sounds.end(); ++it) {
-			Mix_FreeChunk(it->second);
+		for (size_t i = 0; i < sounds.items.size(); i++) {
+			if (sounds.loaded[i]) Mix_FreeChunk(sounds.items[i]);
 		}
-		sounds.clear();
-
-		TTF_CloseFont(fntCirno);
+		sounds.Clear();
+		sound_queue.clear();
+		sound_queued.clear();
+		sound_channels.clear();
+
+		if (fntCirnoGlyphs) {
+			SDL_DestroyTexture(fntCirnoGlyphs->texture);
+			delete fntCirnoGlyphs;
+			fntCirnoGlyphs = nullptr;
+		}
+		if (fntCirno) TTF_CloseFont(fntCirno);
 		delete fntMain;
 
 		for (auto it = scripts.begin(); it != scripts.end(); ++it) {
 			delete it->second;
 		}
 		scripts.clear();
+		bytecode_cache.clear();
 
-		for (auto it = sprites.begin(); it != sprites.end(); ++it) {
-			delete it->second;
-		}
-		sprites.clear();
+		sprites.Clear();
+		default_sprite = nullptr;
 
-		for (auto it = textures.begin(); it != textures.end(); ++it) {
-			SDL_DestroyTexture(it->second);
+		for (SDL_Texture* page : atlas_pages) {
+			SDL_DestroyTexture(page);
 		}
-		textures.clear();
-	}
+		atlas_pages.clear();
 
-	SpriteData* Assets::GetSprite(const std::string& name) {
-		auto lookup = sprites.find(name);
-		if (lookup != sprites.end()) {
-			return lookup->second;
+		for (size_t i = 0; i < textures.items.size(); i++) {
+			if (textures.loaded[i] && textures.items[i]) SDL_DestroyTexture(textures.items[i]);
 		}
-		return default_sprite;
+		textures.Clear();
+		default_texture = nullptr;
 	}
 
-	SDL_Texture* Assets::GetTexture(const std::string& name) {
-		auto lookup = textures.find(name);
-		if (lookup != textures.end()) {
-			return lookup->second;
+	bool Assets::LoadTextureIfNotLoaded(const std::string& fname, SDL_Renderer* renderer) {
+		int id = textures.Intern(fname, default_texture);
+		if (id < 0) {
+			TH_LOG_ERROR("texture name %s collides with another one", fname.c_str());
+			return false;
 		}
-		return default_texture;
-	}
 
-	Mix_Chunk* Assets::GetSound(const std::string& name) {
-		auto lookup = sounds.find(name);
-		if (lookup != sounds.end()) {
-			return lookup->second;
-		}
-		return nullptr;
-	}
+		if (!textures.loaded[id]) {
+			if (!renderer) {
+				textures.items[id] = nullptr;
+				textures.loaded[id] = 1;
+				return true;
+			}
 
-	bool Assets::LoadTextureIfNotLoaded(const std::string& fname, SDL_Renderer* renderer) {
-		auto lookup = textures.find(fname);
-		if (lookup == textures.end()) {
 			std::string fullPath = assetsFolder + fname;
 
 			SDL_Texture* texture;
@@ -323,12 +428,57 @@ namespace th {
 				return false;
 			}
 
-			textures.emplace(fname, texture);
+			textures.items[id] = texture;
+			textures.loaded[id] = 1;
 		}
 
 		return true;
 	}
 
+	// FNV-1a like HashAssetName, over a buffer
+	static unsigned int HashBytes(const char* data, size_t size) {
+		unsigned int hash = 2166136261u;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= (unsigned char)data[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	static int WriteBytecode(lua_State* L, const void* p, size_t size, void* ud) {
+		std::vector<char>& out = *(std::vector<char>*)ud;
+		out.insert(out.end(), (const char*)p, (const char*)p + size);
+		return 0;
+	}
+
+	int Assets::LoadScriptChunk(lua_State* L, const ScriptData* script, const char* name, bool* cached) {
+		if (cached) *cached = false;
+
+		auto lookup = bytecode_cache.find(script->hash);
+		if (lookup != bytecode_cache.end() && lookup->second.source_size == script->buffer.size()) {
+			const std::vector<char>& bytecode = lookup->second.data;
+			if (luaL_loadbufferx(L, bytecode.data(), bytecode.size(), name, "b") == LUA_OK) {
+				if (cached) *cached = true;
+				return LUA_OK;
+			}
+			lua_pop(L, 1);
+			bytecode_cache.erase(lookup);
+		}
+
+		int res = luaL_loadbufferx(L, script->buffer.data(), script->buffer.size(), name, "t");
+		if (res != LUA_OK) {
+			return res;
+		}
+
+		// debug info is kept, so errors still point at the source lines
+		Bytecode bytecode;
+		bytecode.source_size = script->buffer.size();
+		if (lua_dump(L, WriteBytecode, &bytecode.data, 0) == 0) {
+			bytecode_cache[script->hash] = std::move(bytecode);
+		}
+		return LUA_OK;
+	}
+
 	bool Assets::LoadScriptIfNotLoaded(const std::string& fname, int stage_index) {
 		auto lookup = scripts.find(fname);
 		if (lookup == scripts.end()) {
@@ -352,6 +502,7 @@ namespace th {
 			script->buffer.resize((size_t)size);
 			file.read(script->buffer.data(), size);
 			script->stage_index = stage_index;
+			script->hash = HashBytes(script->buffer.data(), script->buffer.size());
 
 			scripts.emplace(fname, script);
 		}
@@ -359,9 +510,300 @@ namespace th {
 		return true;
 	}
 
+	GlyphAtlas* Assets::BuildGlyphAtlas(TTF_Font* font, SDL_Renderer* renderer) {
+		TH_PROFILE_SCOPE("Assets::BuildGlyphAtlas");
+
+		constexpr int ATLAS_W = 512;
+		constexpr int GLYPH_COUNT = GlyphAtlas::LAST - GlyphAtlas::FIRST + 1;
+
+		GlyphAtlas* atlas = new GlyphAtlas{};
+		atlas->line_skip = TTF_FontLineSkip(font);
+
+		// Each glyph is rendered as one-character text, so it sits in its cell
+		// exactly where TTF_RenderText would have put it.
+		SDL_Surface* surfaces[GLYPH_COUNT]{};
+		int shelf_x = 0;
+		int shelf_y = 0;
+		int shelf_h = 0;
+		for (int i = 0; i < GLYPH_COUNT; i++) {
+			char text[2] = {(char)(GlyphAtlas::FIRST + i), 0};
+			GlyphAtlas::Glyph& glyph = atlas->glyphs[i];
+
+			int minx = 0;
+			int maxx = 0;
+			int miny = 0;
+			int maxy = 0;
+			int advance = 0;
+			TTF_GlyphMetrics(font, (Uint16)text[0], &minx, &maxx, &miny, &maxy, &advance);
+			glyph.xoffset = std::min(minx, 0);
+			glyph.advance = advance;
+
+			if (text[0] == ' ') continue;
+
+			SDL_Surface* surface = TTF_RenderText_Blended(font, text, {255, 255, 255, 255});
+			if (!surface) continue;
+			surfaces[i] = surface;
+
+			if (shelf_x + surface->w > ATLAS_W) {
+				shelf_x = 0;
+				shelf_y += shelf_h;
+				shelf_h = 0;
+			}
+			glyph.src = {shelf_x, shelf_y, surface->w, surface->h};
+			shelf_x += surface->w;
+			shelf_h = std::max(shelf_h, surface->h);
+		}
+
+		SDL_Surface* atlas_surface = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_W, std::max(shelf_y + shelf_h, 1), 32, SDL_PIXELFORMAT_RGBA32);
+		if (atlas_surface) {
+			SDL_FillRect(atlas_surface, nullptr, 0);
+			for (int i = 0; i < GLYPH_COUNT; i++) {
+				if (surfaces[i]) {
+					SDL_SetSurfaceBlendMode(surfaces[i], SDL_BLENDMODE_NONE);
+					SDL_BlitSurface(surfaces[i], nullptr, atlas_surface, &atlas->glyphs[i].src);
+				}
+			}
+			atlas->texture = SDL_CreateTextureFromSurface(renderer, atlas_surface);
+			SDL_FreeSurface(atlas_surface);
+		}
+
+		for (int i = 0; i < GLYPH_COUNT; i++) {
+			if (surfaces[i]) SDL_FreeSurface(surfaces[i]);
+		}
+
+		if (!atlas->texture) {
+			TH_LOG_ERROR("couldn't create glyph atlas: %s", SDL_GetError());
+			delete atlas;
+			return nullptr;
+		}
+
+		SDL_SetTextureBlendMode(atlas->texture, SDL_BLENDMODE_BLEND);
+		return atlas;
+	}
+
+	// Copies the regions used by sprites and the bitmap font out of their
+	// sheets into as few large pages as possible, so interleaved draws of
+	// different sprites mostly hit the same texture and batch together.
+	// Whole-texture draws (backgrounds, the logo) keep their own textures.
+	bool Assets::BuildSpriteAtlas(SDL_Renderer* renderer) {
+		TH_PROFILE_SCOPE("Assets::BuildSpriteAtlas");
+
+		constexpr int PADDING = 1;
+
+		struct Region {
+			SDL_Texture* sheet;
+			SDL_Rect src;
+			int page;
+			SDL_Rect dest;
+		};
+
+		std::unordered_map<SDL_Texture*, std::string> sheet_names;
+		for (size_t i = 0; i < textures.items.size(); i++) {
+			if (textures.loaded[i] && textures.items[i] && textures.items[i] != default_texture) {
+				sheet_names.emplace(textures.items[i], textures.names[i]);
+			}
+		}
+
+		// sprites cut from the same part of a sheet share a region
+		std::vector<Region> regions;
+		auto add_region = [&](SDL_Texture* sheet, SDL_Rect src) -> int {
+			for (size_t i = 0; i < regions.size(); i++) {
+				const Region& r = regions[i];
+				if (r.sheet == sheet && r.src.x == src.x && r.src.y == src.y && r.src.w == src.w && r.src.h == src.h) {
+					return (int)i;
+				}
+			}
+			regions.push_back({sheet, src, -1, {}});
+			return (int)regions.size() - 1;
+		};
+
+		std::vector<std::pair<SpriteData*, int>> sprite_regions;
+		for (SpriteData& sprite_data : sprites.items) {
+			SpriteData* sprite = &sprite_data;
+			if (!sheet_names.count(sprite->texture)) continue;
+
+			int rows = (sprite->frame_count + sprite->frames_in_row - 1) / sprite->frames_in_row;
+			SDL_Rect src{sprite->u, sprite->v, sprite->width * sprite->frames_in_row, sprite->height * rows};
+			sprite_regions.emplace_back(sprite, add_region(sprite->texture, src));
+		}
+
+		int font_region = -1;
+		if (fntMain && sheet_names.count(fntMain->texture)) {
+			SDL_Rect src{fntMain->u, fntMain->v, 0, 0};
+			SDL_QueryTexture(fntMain->texture, nullptr, nullptr, &src.w, &src.h);
+			font_region = add_region(fntMain->texture, src);
+		}
+
+		if (regions.empty()) return true;
+
+		// shelf packing, tallest first
+		int page_w = 2048;
+		int page_h = 2048;
+		{
+			SDL_RendererInfo info;
+			if (SDL_GetRendererInfo(renderer, &info) == 0 && info.max_texture_width > 0 && info.max_texture_height > 0) {
+				page_w = std::min(page_w, info.max_texture_width);
+				page_h = std::min(page_h, info.max_texture_height);
+			}
+		}
+
+		std::vector<int> order(regions.size());
+		for (size_t i = 0; i < order.size(); i++) order[i] = (int)i;
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+			return regions[a].src.h > regions[b].src.h;
+		});
+
+		std::vector<int> page_heights;
+		int shelf_x = 0;
+		int shelf_y = 0;
+		int shelf_h = 0;
+		for (int i : order) {
+			Region& r = regions[i];
+			int w = r.src.w + PADDING;
+			int h = r.src.h + PADDING;
+			if (w > page_w || h > page_h) continue; // too big, keeps its sheet
+
+			if (shelf_x + w > page_w) {
+				shelf_x = 0;
+				shelf_y += shelf_h;
+				shelf_h = 0;
+			}
+			if (page_heights.empty() || shelf_y + h > page_h) {
+				page_heights.push_back(0);
+				shelf_x = 0;
+				shelf_y = 0;
+				shelf_h = 0;
+			}
+			r.page = (int)page_heights.size() - 1;
+			r.dest = {shelf_x, shelf_y, r.src.w, r.src.h};
+			shelf_x += w;
+			shelf_h = std::max(shelf_h, h);
+			page_heights.back() = std::max(page_heights.back(), shelf_y + shelf_h);
+		}
+
+		// the sheets' pixels, textures can't be read back
+		std::unordered_map<SDL_Texture*, SDL_Surface*> sheet_surfaces;
+		bool result = true;
+		for (const Region& r : regions) {
+			if (r.page < 0 || sheet_surfaces.count(r.sheet)) continue;
+
+			std::string fullPath = assetsFolder + sheet_names[r.sheet];
+			SDL_Surface* surface = IMG_Load(fullPath.c_str());
+			if (surface) {
+				SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+				SDL_FreeSurface(surface);
+				surface = converted;
+			}
+			if (!surface) {
+				TH_LOG_ERROR("couldn't load %s for the atlas: %s", sheet_names[r.sheet].c_str(), IMG_GetError());
+				result = false;
+			}
+			sheet_surfaces.emplace(r.sheet, surface);
+		}
+
+		std::vector<SDL_Texture*> pages(page_heights.size());
+		for (size_t p = 0; p < pages.size(); p++) {
+			SDL_Surface* page_surface = SDL_CreateRGBSurfaceWithFormat(0, page_w, page_heights[p], 32, SDL_PIXELFORMAT_RGBA32);
+			if (!page_surface) {
+				TH_LOG_ERROR("couldn't create atlas page: %s", SDL_GetError());
+				result = false;
+				continue;
+			}
+			SDL_FillRect(page_surface, nullptr, 0);
+
+			for (Region& r : regions) {
+				if (r.page != (int)p) continue;
+				SDL_Surface* sheet = sheet_surfaces[r.sheet];
+				if (!sheet) continue;
+				SDL_SetSurfaceBlendMode(sheet, SDL_BLENDMODE_NONE);
+				SDL_Rect dest = r.dest;
+				SDL_BlitSurface(sheet, &r.src, page_surface, &dest);
+			}
+
+			pages[p] = SDL_CreateTextureFromSurface(renderer, page_surface);
+			SDL_FreeSurface(page_surface);
+			if (!pages[p]) {
+				TH_LOG_ERROR("couldn't create atlas page: %s", SDL_GetError());
+				result = false;
+				continue;
+			}
+			SDL_SetTextureBlendMode(pages[p], SDL_BLENDMODE_BLEND);
+			atlas_pages.push_back(pages[p]);
+		}
+
+		for (auto it = sheet_surfaces.begin(); it != sheet_surfaces.end(); ++it) {
+			if (it->second) SDL_FreeSurface(it->second);
+		}
+
+		// point the sprites at their copies, anything that failed stays on its sheet
+		auto moved = [&](int i) {
+			const Region& r = regions[i];
+			return r.page >= 0 && pages[r.page] && sheet_surfaces[r.sheet];
+		};
+
+		for (auto& [sprite, i] : sprite_regions) {
+			if (!moved(i)) continue;
+			const Region& r = regions[i];
+			sprite->texture = pages[r.page];
+			sprite->u = r.dest.x;
+			sprite->v = r.dest.y;
+		}
+
+		if (font_region >= 0 && moved(font_region)) {
+			const Region& r = regions[font_region];
+			fntMain->texture = pages[r.page];
+			fntMain->u = r.dest.x;
+			fntMain->v = r.dest.y;
+		}
+
+		return result;
+	}
+
+	void Assets::QueueSound(SoundId id) {
+		if (!GetSound(id)) return;
+		if (sound_queued[id]) return;
+		sound_queued[id] = 1;
+		sound_queue.push_back(id);
+	}
+
+	void Assets::HaltSound(SoundId id) {
+		if (IsSoundPlaying(id)) {
+			Mix_HaltChannel(sound_channels[id]);
+		}
+		if (id > 0 && id < (int)sound_queued.size()) {
+			sound_queued[id] = 0;
+		}
+	}
+
+	// the channel may have finished or been taken by another sound since
+	bool Assets::IsSoundPlaying(SoundId id) {
+		Mix_Chunk* sound = GetSound(id);
+		if (!sound) return false;
+		int channel = sound_channels[id];
+		return channel >= 0 && Mix_Playing(channel) && Mix_GetChunk(channel) == sound;
+	}
+
+	void Assets::FlushSounds() {
+		for (SoundId id : sound_queue) {
+			if (!sound_queued[id]) continue; // stopped after it was queued
+			sound_queued[id] = 0;
+
+			if (IsSoundPlaying(id)) {
+				Mix_HaltChannel(sound_channels[id]);
+			}
+			sound_channels[id] = Mix_PlayChannel(-1, sounds.items[id], 0);
+		}
+		sound_queue.clear();
+	}
+
 	bool Assets::LoadSoundIfNotLoaded(const std::string& fname) {
-		auto lookup = sounds.find(fname);
-		if (lookup == sounds.end()) {
+		int id = sounds.Intern(fname, nullptr);
+		if (id < 0) {
+			TH_LOG_ERROR("sound name %s collides with another one", fname.c_str());
+			return false;
+		}
+
+		if (!sounds.loaded[id]) {
 			std::string fullPath = assetsFolder + fname;
 
 			Mix_Chunk* chunk;
@@ -371,7 +813,8 @@ namespace th {
 				return false;
 			}
 
-			sounds.emplace(fname, chunk);
+			sounds.items[id] = chunk;
+			sounds.loaded[id] = 1;
 		}
 
 		return true;
@@ -6,11 +6,80 @@
 
 #include <unordered_map>
 #include <string>
+#include <vector>
+
+struct lua_State;
 
 namespace th {
 
 	class Game;
 
+	// Handles index the flat asset arrays in Assets and stay valid until
+	// UnloadAssets. Names are interned by their hash at load.
+	typedef int SpriteId;
+	typedef int TextureId;
+	typedef int SoundId;
+
+	// FNV-1a, also usable in constant expressions
+	constexpr unsigned int HashAssetName(const char* name) {
+		unsigned int hash = 2166136261u;
+		for (; *name; name++) {
+			hash ^= (unsigned char)*name;
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	// Assets the engine refers to by name. Their names are interned first,
+	// so the handles are known at compile time; the names are in Assets.cpp.
+	enum : SpriteId {
+		SPR_DEFAULT,
+		SPR_HITBOX,
+		SPR_PICKUP,
+		SPR_LAZER,
+		SPR_SIDEBAR,
+		SPR_UI_LIFE,
+		SPR_UI_BOMB,
+		SPR_ENEMY_LABEL,
+		SPR_REIMU_CARD,
+		SPR_REIMU_ORB_SHOT,
+
+		ENGINE_SPRITE_COUNT
+	};
+
+	enum : TextureId {
+		TEX_DEFAULT,
+		TEX_BACKGROUND,
+		TEX_LOGO,
+		TEX_SPELLCARD_BG,
+		TEX_FONT,
+		TEX_MISTY_LAKE,
+
+		ENGINE_TEXTURE_COUNT
+	};
+
+	enum : SoundId {
+		SND_NONE,
+		SND_PAUSE,
+		SND_CANCEL,
+		SND_OK,
+		SND_SELECT,
+		SND_EXTEND,
+		SND_POWERUP,
+		SND_ENEMY_SHOOT,
+		SND_LAZER,
+		SND_GRAZE,
+		SND_PICHUUN,
+		SND_ITEM,
+		SND_ENEMY_HIT,
+		SND_ENEMY_DIE,
+		SND_BOSS_DIE,
+		SND_SPELLCARD,
+		SND_PLST00,
+
+		ENGINE_SOUND_COUNT
+	};
+
 	struct SpriteData {
 		SDL_Texture* texture;
 		int u;
@@ -33,49 +102,142 @@ namespace th {
 		int sep_x;
 		int sep_y;
 		int frames_in_row;
+		int u = 0; // top left of the glyph grid in the texture
+		int v = 0;
+	};
+
+	// printable ascii of a ttf font, rasterized once into one texture
+	struct GlyphAtlas {
+		static constexpr unsigned char FIRST = ' ';
+		static constexpr unsigned char LAST = '~';
+
+		struct Glyph {
+			SDL_Rect src;
+			int xoffset;
+			int advance;
+		};
+
+		SDL_Texture* texture;
+		int line_skip;
+		Glyph glyphs[LAST - FIRST + 1];
 	};
 
 	struct ScriptData {
 		std::vector<char> buffer;
 		int stage_index;
+		unsigned int hash; // of the source, keys the bytecode cache
 	};
 
 	void DrawSprite(SDL_Renderer* renderer, SpriteData* sprite, int frame_index, float x, float y, float angle = 0.0f, float xscale = 1.0f, float yscale = 1.0f, SDL_Color color = {255, 255, 255, 255});
 
 	void DrawTextBitmap(SDL_Renderer* renderer, SpriteFont* font, const char* text, int x, int y);
 
-	void StopSound(Mix_Chunk* sound);
+	// width of the longest line
+	int MeasureText(GlyphAtlas* atlas, const char* text);
+
+	void StopSound(SoundId sound);
 
-	bool SoundPlaying(Mix_Chunk* sound);
+	bool SoundPlaying(SoundId sound);
 
-	void PlaySound(const std::string& name);
+	// Sounds are queued and played at the end of the frame, several requests
+	// for one sound in the same frame play it once. Playing a sound that is
+	// already playing restarts it.
+	void PlaySound(SoundId sound);
+	void PlaySound(const char* name);
 
 	class Assets {
 	public:
 		bool LoadAssets(SDL_Renderer* renderer);
 		void UnloadAssets();
 
-		SpriteData* GetSprite(const std::string& name);
-		SDL_Texture* GetTexture(const std::string& name);
-		Mix_Chunk* GetSound(const std::string& name);
+		SpriteData* GetSprite(SpriteId id) { return (id >= 0 && id < (int)sprites.items.size()) ? &sprites.items[id] : default_sprite; }
+		SDL_Texture* GetTexture(TextureId id) { return (id >= 0 && id < (int)textures.items.size()) ? textures.items[id] : default_texture; }
+		Mix_Chunk* GetSound(SoundId id) { return (id > 0 && id < (int)sounds.items.size()) ? sounds.items[id] : nullptr; }
+
+		// by name, for scripts and data tables
+		SpriteData* GetSprite(const char* name) { return GetSprite(sprites.Find(name)); }
+		SDL_Texture* GetTexture(const char* name) { return GetTexture(textures.Find(name)); }
+		SoundId FindSound(const char* name) { int id = sounds.Find(name); return (id >= 0) ? id : SND_NONE; }
 
 		const std::unordered_map<std::string, ScriptData*>& GetScripts() const { return scripts; }
 
+		// Pushes the script's compiled chunk like luaL_loadbuffer. The first
+		// load compiles the source and keeps the bytecode, later stage starts
+		// and restarts load that instead.
+		int LoadScriptChunk(lua_State* L, const ScriptData* script, const char* name, bool* cached = nullptr);
+
+		void QueueSound(SoundId id);
+		void HaltSound(SoundId id);
+		bool IsSoundPlaying(SoundId id);
+		void FlushSounds();
+
 		SpriteFont* fntMain = nullptr;
 		TTF_Font* fntCirno = nullptr;
+		GlyphAtlas* fntCirnoGlyphs = nullptr;
 
 	private:
 		bool LoadTextureIfNotLoaded(const std::string& fname, SDL_Renderer* renderer);
 		bool LoadScriptIfNotLoaded(const std::string& fname, int stage_index);
 		bool LoadSoundIfNotLoaded(const std::string& fname);
 
+		static GlyphAtlas* BuildGlyphAtlas(TTF_Font* font, SDL_Renderer* renderer);
+		bool BuildSpriteAtlas(SDL_Renderer* renderer);
+
 		std::string assetsFolder = "Assets/";
 
-		std::unordered_map<std::string, SDL_Texture*> textures;
-		std::unordered_map<std::string, SpriteData*> sprites; // todo: just use SpriteData, they won't be moved in memory
-															  // actual todo: replace this with a proper asset manager
+		template <typename T>
+		struct AssetTable {
+			std::vector<T> items;
+			std::vector<std::string> names;
+			std::vector<unsigned char> loaded;
+			std::unordered_map<unsigned int, int> ids; // name hash -> handle
+
+			int Find(const char* name) const {
+				auto lookup = ids.find(HashAssetName(name));
+				return (lookup != ids.end()) ? lookup->second : -1;
+			}
+
+			// -1 if a different name has the same hash
+			int Intern(const std::string& name, const T& placeholder) {
+				int id = Find(name.c_str());
+				if (id >= 0) {
+					return (names[id] == name) ? id : -1;
+				}
+				id = (int)items.size();
+				items.push_back(placeholder);
+				names.push_back(name);
+				loaded.push_back(0);
+				ids.emplace(HashAssetName(name.c_str()), id);
+				return id;
+			}
+
+			void Clear() {
+				items.clear();
+				names.clear();
+				loaded.clear();
+				ids.clear();
+			}
+		};
+
+		AssetTable<SDL_Texture*> textures;
+		AssetTable<SpriteData> sprites; // pointers handed out after load stay valid
+		AssetTable<Mix_Chunk*> sounds;
 		std::unordered_map<std::string, ScriptData*> scripts;
-		std::unordered_map<std::string, Mix_Chunk*> sounds;
+
+		struct Bytecode {
+			size_t source_size; // guards against hash collisions
+			std::vector<char> data;
+		};
+		std::unordered_map<unsigned int, Bytecode> bytecode_cache; // source hash -> chunk
+
+		// this frame's sound requests, and the channel each sound last
+		// started on, so restarting it doesn't scan the channels
+		std::vector<SoundId> sound_queue;
+		std::vector<unsigned char> sound_queued;
+		std::vector<int> sound_channels;
+
+		// pages the sprite regions were packed into, sprites point here
+		std::vector<SDL_Texture*> atlas_pages;
 
 		SDL_Texture* default_texture = nullptr;
 		SpriteData* default_sprite = nullptr;
@@ -16,6 +16,43 @@ namespace th {
 	Game* Game::_instance = nullptr;
 
 	bool Game::Init() {
+		InitProfiler();
+
+		kinematics = std::min(kinematics, DetectKinematicsPath());
+
+		if (!jobs.Init(job_threads)) {
+			jobs.Init(1);
+		}
+
+		if (!replay_path.empty()) {
+			if (!replay.Load(replay_path)) {
+				return false;
+			}
+			stage_index = replay.header.stage_index;
+			player_character = replay.header.player_character;
+			seed = (unsigned long)replay.header.game_seed;
+			stage_seed = (unsigned long)replay.header.stage_seed;
+			skip_to_midboss = replay.header.skip_to_midboss;
+			skip_to_boss = replay.header.skip_to_boss;
+			substep_physics = replay.header.substep_physics;
+		}
+
+		if (headless) {
+			SDL_CheckErrorMsg(SDL_Init(0) == 0, "couldn't initialize SDL");
+
+			assets.LoadAssets(nullptr);
+
+			FillDataTables();
+
+			if (!InitLua()) {
+				return false;
+			}
+
+			next_scene = GAME_SCENE;
+
+			return true;
+		}
+
 		SDL_CheckErrorMsg(SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO) == 0, "couldn't initialize SDL");
 
 		// @hack
@@ -40,6 +77,8 @@ namespace th {
 
 		SDL_CheckError(SDL_SetTextureScaleMode(up_surface, SDL_ScaleModeLinear) == 0);
 
+		sprite_batch.Init(renderer);
+
 		{
 			SDL_RendererInfo info;
 			SDL_CheckError(SDL_GetRendererInfo(renderer, &info) == 0);
@@ -71,7 +110,11 @@ namespace th {
 
 		FillDataTables();
 
-		next_scene = TITLE_SCENE;
+		if (!InitLua()) {
+			return false;
+		}
+
+		next_scene = replay_path.empty() ? TITLE_SCENE : GAME_SCENE;
 
 		SetWindowMode(0);
 
@@ -93,8 +136,26 @@ namespace th {
 			}
 		}
 
+		if (lua) {
+			lua_close(lua);
+			lua = nullptr;
+		}
+		lua_allocator.Release();
+
 		assets.UnloadAssets();
 
+		jobs.Shutdown();
+
+		if (!trace_path.empty()) {
+			WriteChromeTrace(trace_path.c_str());
+		}
+		ShutdownProfiler();
+
+		if (headless) {
+			SDL_Quit();
+			return;
+		}
+
 		TTF_Quit();
 
 		Mix_CloseAudio();
@@ -115,6 +176,10 @@ namespace th {
 	}
 
 	bool Game::Run() {
+		if (headless) {
+			return RunHeadless();
+		}
+
 		double prev_time = GetTime();
 
 		for (bool running = true; running;) {
@@ -167,6 +232,26 @@ namespace th {
 									frame_advance = false;
 									break;
 								}
+								case SDL_SCANCODE_F7: {
+									int count = DetectKinematicsPath() + 1;
+									kinematics = (KinematicsPath)((kinematics + 1) % count);
+									break;
+								}
+								case SDL_SCANCODE_F8: {
+									// the input stream can't reproduce a switch
+									if (replay.IsRecording() || replay.IsPlaying()) {
+										break;
+									}
+									substep_physics ^= true;
+									break;
+								}
+								case SDL_SCANCODE_F9: {
+									const char* fname = trace_path.empty() ? "trace.json" : trace_path.c_str();
+									if (WriteChromeTrace(fname)) {
+										printf("wrote %s\n", fname);
+									}
+									break;
+								}
 							}
 						}
 						break;
@@ -180,6 +265,10 @@ namespace th {
 
 			Draw(delta);
 
+			if (scene.index() == GAME_SCENE && game_scene->stage) {
+				game_scene->stage->CollectGarbage(frame_end_time - GetTime());
+			}
+
 			double current_time = GetTime();
 			frame_took = current_time - prev_time;
 			fps = 1.0 / (current_time - prev_time);
@@ -203,7 +292,77 @@ namespace th {
 		return true;
 	}
 
+	bool Game::RunHeadless() {
+		int frames = 0;
+		double bullet_frames = 0.0;
+		size_t max_bullets = 0;
+
+		double start_t = GetTime();
+
+		// a replay runs to its end
+		bool replaying = !replay_path.empty();
+
+		for (; replaying || frames < headless_frames; frames++) {
+			float delta = 1.0f;
+
+			Update(delta);
+
+			if (scene.index() != GAME_SCENE || replay_finished) {
+				break;
+			}
+
+			size_t bullet_count = game_scene->stage->bullets.size();
+			bullet_frames += (double)bullet_count;
+			max_bullets = std::max(max_bullets, bullet_count);
+		}
+
+		double took = GetTime() - start_t;
+
+		printf("stage %d, seed %lu, kinematics %s, %s physics, %d threads\n", stage_index, seed, GetKinematicsPathName(kinematics), substep_physics ? "substep" : "swept", jobs.GetWorkerCount());
+		printf("%d frames in %.3fs (%.1f fps)\n", frames, took, (frames > 0) ? (double)frames / took : 0.0);
+		printf("%.2fus per frame\n", (frames > 0) ? 1'000'000.0 * took / (double)frames : 0.0);
+		printf("%.2fns per bullet (avg %.1f, max %d bullets)\n",
+			   (bullet_frames > 0.0) ? 1'000'000'000.0 * took / bullet_frames : 0.0,
+			   (frames > 0) ? bullet_frames / (double)frames : 0.0,
+			   (int)max_bullets);
+
+		return true;
+	}
+
+	bool Game::ReadInput() {
+		if (!replay_path.empty()) {
+			if (!replay.Next(&input)) {
+				input = 0;
+				return false;
+			}
+			return true;
+		}
+
+		input = 0;
+
+		if (!headless) {
+			const unsigned char* key = SDL_GetKeyboardState(nullptr);
+			if (key[SDL_SCANCODE_LEFT])   input |= INPUT_LEFT;
+			if (key[SDL_SCANCODE_RIGHT])  input |= INPUT_RIGHT;
+			if (key[SDL_SCANCODE_UP])     input |= INPUT_UP;
+			if (key[SDL_SCANCODE_DOWN])   input |= INPUT_DOWN;
+			if (key[SDL_SCANCODE_LSHIFT]) input |= INPUT_FOCUS;
+			if (key[SDL_SCANCODE_Z])      input |= INPUT_SHOT;
+			if (key[SDL_SCANCODE_X])      input |= INPUT_BOMB;
+
+			if (debug) {
+				if (key_pressed[SDL_SCANCODE_P]) input |= INPUT_DEBUG_POWER;
+				if (key_pressed[SDL_SCANCODE_B]) input |= INPUT_DEBUG_END_PHASE;
+			}
+		}
+
+		replay.Record(input);
+		return true;
+	}
+
 	void Game::Update(float delta) {
+		TH_PROFILE_SCOPE("Game::Update");
+
 		double update_start_t = GetTime();
 		everything_start_t = GetTime();
 
@@ -223,7 +382,7 @@ namespace th {
 			SceneIndex s = next_scene;
 			next_scene = (SceneIndex)0;
 
-			random.seed();
+			random.seed(seed);
 
 			static_assert(LAST_SCENE == 3);
 			switch (s) {
@@ -254,11 +413,15 @@ namespace th {
 			}
 		}
 
+		assets.FlushSounds();
+
 		double update_end_t = GetTime();
 		update_took = update_end_t - update_start_t;
 	}
 
 	void Game::Draw(float delta) {
+		TH_PROFILE_SCOPE("Game::Draw");
+
 		double draw_start_t = GetTime();
 
 #if 1
@@ -277,12 +440,12 @@ namespace th {
 		{
 			char buf[11];
 			stbsp_snprintf(buf, sizeof(buf), "%7.2ffps", fps);
-			DrawTextBitmap(renderer, assets.fntMain, buf, 30 * 16, 29 * 16);
+			sprite_batch.DrawTextBitmap(assets.fntMain, buf, 30 * 16, 29 * 16);
 		}
 
 		// DEBUG
 		if (show_debug) {
-			char buf[100];
+			char buf[256];
 			stbsp_snprintf(
 				buf,
 				sizeof(buf),
@@ -290,29 +453,25 @@ namespace th {
 				"update %.2fms\n"
 				"draw %.2fms\n"
 				"everything %.2fms\n"
-				"frame %.2fms",
+				"frame %.2fms\n"
+				"kinematics %s (F7)\n"
+				"physics %s (F8)\n"
+				"%d job threads\n"
+				"%d batches %d quads",
 				(int)SDL_GetNumAllocations(),
 				1000.0 * update_took,
 				1000.0 * draw_took,
 				1000.0 * everything_took,
-				1000.0 * frame_took
+				1000.0 * frame_took,
+				GetKinematicsPathName(kinematics),
+				substep_physics ? "substep" : "swept",
+				jobs.GetWorkerCount(),
+				sprite_batch.GetBatches(), sprite_batch.GetQuads()
 			);
 			int x = 0;
 			int y = 0;
-			SDL_Surface* surface = TTF_RenderText_Blended_Wrapped(assets.fntCirno, buf, {255, 255, 255, 255}, 0);
-			SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-			{
-				SDL_SetTextureColorMod(texture, 0, 0, 0);
-				SDL_Rect dest{x + 1, y + 1, surface->w, surface->h};
-				SDL_RenderCopy(renderer, texture, nullptr, &dest);
-			}
-			{
-				SDL_SetTextureColorMod(texture, 255, 128, 128);
-				SDL_Rect dest{x, y, surface->w, surface->h};
-				SDL_RenderCopy(renderer, texture, nullptr, &dest);
-			}
-			SDL_DestroyTexture(texture);
-			SDL_FreeSurface(surface);
+			sprite_batch.DrawText(assets.fntCirnoGlyphs, buf, x + 1, y + 1, {0, 0, 0, 255});
+			sprite_batch.DrawText(assets.fntCirnoGlyphs, buf, x, y, {255, 128, 128, 255});
 		}
 
 		int window_w;
@@ -330,6 +489,8 @@ namespace th {
 			SDL_SetTextureScaleMode(up_surface, SDL_ScaleModeLinear);
 		}
 
+		sprite_batch.EndFrame();
+
 		SDL_SetRenderTarget(renderer, up_surface);
 		SDL_RenderCopy(renderer, game_surface, nullptr, nullptr);
 
@@ -3,6 +3,12 @@
 #include "Assets.h"
 #include "GameScene.h"
 #include "TitleScene.h"
+#include "JobSystem.h"
+#include "LuaAllocator.h"
+#include "Profiler.h"
+#include "Replay.h"
+#include "SpriteBatch.h"
+#include "bullet_kinematics.h"
 
 #include <variant>
 
@@ -44,6 +50,7 @@ namespace th {
 		Options options{};
 		SDL_Renderer* renderer = nullptr;
 		Assets assets;
+		SpriteBatch sprite_batch;
 		xorshf96 random;
 
 		static_assert(LAST_SCENE == 3);
@@ -75,9 +82,52 @@ namespace th {
 		bool debug = true;
 		bool show_debug = false;
 
+		// headless mode: no window, renderer or audio device, the game scene
+		// is ticked at uncapped speed for `headless_frames` frames
+		bool headless = false;
+		int headless_frames = 60 * 60;
+		unsigned long seed = 123456789;       // Game::random
+		unsigned long stage_seed = 123456789; // Stage::random
+
+		// bullet integration path, lowered to what the cpu supports in Init
+		KinematicsPath kinematics = KINEMATICS_AVX;
+
+		JobSystem jobs;
+		int job_threads = 0; // 0: one per cpu core, 1: single-threaded
+
+		// Lives for the whole run with the bindings and the shared scripts
+		// (stage_index -1) loaded. Each stage run loads its own scripts into
+		// a fresh _ENV on top, see Stage::InitLua.
+		lua_State* lua = nullptr;
+		LuaAllocator lua_allocator; // lua's memory, must outlive it
+
+		// legacy physics: five fixed substeps per frame with overlap tests,
+		// instead of one step with swept collision
+		bool substep_physics = false;
+
+		// INPUT_* bits of the current stage frame. Gameplay code reads this
+		// instead of the keyboard so a replay can drive it.
+		unsigned short input = 0;
+
+		// --record: save the game scene's input, --replay: play it back
+		Replay replay;
+		std::string record_path;
+		std::string replay_path;
+		bool replay_finished = false;
+
+		// F9 writes the profiler's samples here, so does exiting if set with --trace
+		std::string trace_path;
+
+		// called once per stage frame, false when the replay ran out
+		bool ReadInput();
+
 	private:
 		static Game* _instance;
 
+		bool RunHeadless();
+
+		bool InitLua(); // in ScriptGlue.cpp
+
 		void FillDataTables();
 		void SetWindowMode(int mode);
 
@@ -29,9 +29,25 @@ namespace th {
 	}
 
 	bool GameScene::Init() {
-		if (!(play_area_surface = SDL_CreateTexture(game.renderer, TH_SURFACE_FORMAT, SDL_TEXTUREACCESS_TARGET, PLAY_AREA_W, PLAY_AREA_H))) {
-			TH_SHOW_ERROR("couldn't create play area surface : %s", SDL_GetError());
-			return false;
+		if (!game.replay_path.empty()) {
+			game.replay.BeginPlayback();
+		} else if (!game.record_path.empty()) {
+			Replay::Header header;
+			header.stage_index = game.stage_index;
+			header.player_character = game.player_character;
+			header.game_seed = game.seed;
+			header.stage_seed = game.stage_seed;
+			header.skip_to_midboss = game.skip_to_midboss;
+			header.skip_to_boss = game.skip_to_boss;
+			header.substep_physics = game.substep_physics;
+			game.replay.BeginRecording(header);
+		}
+
+		if (!game.headless) {
+			if (!(play_area_surface = SDL_CreateTexture(game.renderer, TH_SURFACE_FORMAT, SDL_TEXTUREACCESS_TARGET, PLAY_AREA_W, PLAY_AREA_H))) {
+				TH_SHOW_ERROR("couldn't create play area surface : %s", SDL_GetError());
+				return false;
+			}
 		}
 
 		ResetStats();
@@ -44,35 +60,82 @@ namespace th {
 	}
 
 	void GameScene::Quit() {
+		if (game.replay.IsRecording()) {
+			if (game.replay.Save(game.record_path, GetChecksum())) {
+				printf("recorded %d frames to %s\n", game.replay.GetFrameCount(), game.record_path.c_str());
+			}
+		}
+
 		stage->Quit();
 
-		SDL_DestroyTexture(play_area_surface);
+		if (play_area_surface) {
+			SDL_DestroyTexture(play_area_surface);
+		}
 	}
 
 	void GameScene::Update(float delta) {
 		if (game.key_pressed[SDL_SCANCODE_ESCAPE] || game.key_pressed[SDL_SCANCODE_RETURN]) {
 			paused ^= true;
-			if (paused) PlaySound("se_pause.wav");
+			if (paused) PlaySound(SND_PAUSE);
 		}
 
 		if (paused) {
 			if (game.key_pressed[SDL_SCANCODE_X]) {
 				game.GoToScene(TITLE_SCENE);
-				PlaySound("se_cancel.wav");
+				PlaySound(SND_CANCEL);
 			}
 			if (game.key_pressed[SDL_SCANCODE_Z]) {
 				paused = false;
-				PlaySound("se_ok.wav");
+				PlaySound(SND_OK);
 			}
 		} else {
-			if (!game.skip_frame) {
-				stage->Update(delta);
+			if (!game.skip_frame && !game.replay_finished) {
+				if (game.ReadInput()) {
+					if (game.input & INPUT_DEBUG_POWER) GetPower(8);
+
+					stage->Update(delta);
+				} else {
+					// the replay ran out
+					game.replay_finished = true;
+
+					unsigned int checksum = GetChecksum();
+					if (checksum == game.replay.checksum) {
+						printf("replay finished after %d frames, state matches the recording\n", game.replay.GetFrameCount());
+					} else {
+						TH_LOG_ERROR("replay desynced: checksum %08x, recorded %08x", checksum, game.replay.checksum);
+					}
+
+					// back to normal play
+					if (!game.headless) {
+						game.replay_path.clear();
+						game.replay_finished = false;
+						game.GoToScene(TITLE_SCENE);
+					}
+				}
 			}
 		}
+	}
 
-		if (game.debug) {
-			if (game.key_pressed[SDL_SCANCODE_P]) GetPower(8);
+	unsigned int GameScene::GetChecksum() {
+		unsigned int hash = 2166136261u;
+		auto add = [&](const void* data, size_t size) {
+			for (size_t i = 0; i < size; i++) {
+				hash ^= ((const unsigned char*)data)[i];
+				hash *= 16777619u;
+			}
+		};
+
+		add(&stats, sizeof(stats));
+		add(&stage->player.x, sizeof(float));
+		add(&stage->player.y, sizeof(float));
+		add(&stage->time, sizeof(float));
+		unsigned int counts[3] = {(unsigned int)stage->bullets.size(), (unsigned int)stage->enemies.size(), (unsigned int)stage->pickups.size()};
+		add(counts, sizeof(counts));
+		for (size_t i = 0, n = stage->bullets.size(); i < n; i++) {
+			add(&stage->bullets.x[i], sizeof(float));
+			add(&stage->bullets.y[i], sizeof(float));
 		}
+		return hash;
 	}
 
 	void GameScene::ResetStats() {
@@ -82,10 +145,14 @@ namespace th {
 	}
 
 	void GameScene::Draw(SDL_Renderer* renderer, SDL_Texture* target, float delta) {
+		TH_PROFILE_SCOPE("GameScene::Draw");
+
 		if (!paused) {
 			stage->Draw(renderer, play_area_surface, delta);
 		}
 
+		SpriteBatch& batch = game.sprite_batch;
+
 		SDL_SetRenderTarget(renderer, target);
 		{
 			SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
@@ -93,7 +160,7 @@ namespace th {
 
 			// bg
 			{
-				SDL_Texture* texture = game.assets.GetTexture("Background.png");
+				SDL_Texture* texture = game.assets.GetTexture(TEX_BACKGROUND);
 				SDL_RenderCopy(renderer, texture, nullptr, nullptr);
 			}
 
@@ -112,7 +179,7 @@ namespace th {
 				SDL_RenderCopy(renderer, play_area_surface, nullptr, &dest);
 
 				if (paused) {
-					DrawTextBitmap(renderer, game.assets.fntMain, "PAUSED", PLAY_AREA_X + (PLAY_AREA_W - (6 * 15)) / 2, PLAY_AREA_Y + (PLAY_AREA_H - 16) / 2);
+					batch.DrawTextBitmap(game.assets.fntMain, "PAUSED", PLAY_AREA_X + (PLAY_AREA_W - (6 * 15)) / 2, PLAY_AREA_Y + (PLAY_AREA_H - 16) / 2);
 				}
 			}
 
@@ -120,10 +187,10 @@ namespace th {
 
 			// sidebar
 			{
-				SpriteData* sprite = game.assets.GetSprite("Sidebar");
+				SpriteData* sprite = game.assets.GetSprite(SPR_SIDEBAR);
 				float x = (float)(PLAY_AREA_X + PLAY_AREA_W + 16);
 				float y = (float)(PLAY_AREA_Y + 32);
-				DrawSprite(renderer, sprite, 0, x, y, 0.0f);
+				batch.DrawSprite(sprite, 0, x, y, 0.0f);
 			}
 
 			// STATS
@@ -135,30 +202,30 @@ namespace th {
 				{
 					char buf[10];
 					stbsp_snprintf(buf, sizeof(buf), "%09d", 0);
-					DrawTextBitmap(renderer, game.assets.fntMain, buf, x, y);
+					batch.DrawTextBitmap(game.assets.fntMain, buf, x, y);
 				}
 				// score
 				{
 					char buf[10];
 					stbsp_snprintf(buf, sizeof(buf), "%09d", stats.score);
-					DrawTextBitmap(renderer, game.assets.fntMain, buf, x, y + 16);
+					batch.DrawTextBitmap(game.assets.fntMain, buf, x, y + 16);
 				}
 				// lives
 				{
-					SpriteData* sprite = game.assets.GetSprite("UI_Life");
+					SpriteData* sprite = game.assets.GetSprite(SPR_UI_LIFE);
 					for (int i = 0; i < stats.lives; i++) {
 						int xx = x + i * 16;
 						int yy = y + 3 * 16;
-						DrawSprite(renderer, sprite, 0, (float)xx, (float)yy);
+						batch.DrawSprite(sprite, 0, (float)xx, (float)yy);
 					}
 				}
 				// bombs
 				{
-					SpriteData* sprite = game.assets.GetSprite("UI_Bomb");
+					SpriteData* sprite = game.assets.GetSprite(SPR_UI_BOMB);
 					for (int i = 0; i < stats.bombs; i++) {
 						int xx = x + i * 16;
 						int yy = y + 4 * 16;
-						DrawSprite(renderer, sprite, 0, (float)xx, (float)yy);
+						batch.DrawSprite(sprite, 0, (float)xx, (float)yy);
 					}
 				}
 				// power
@@ -168,6 +235,7 @@ namespace th {
 					rect.y = y + 6 * 16;
 					rect.w = (int)(135.0f * ((float)stats.power / (float)MAX_POWER));
 					rect.h = 16;
+					batch.Flush();
 					SDL_SetRenderDrawColor(renderer, 200, 200, 200, 255);
 					SDL_RenderFillRect(renderer, &rect);
 
@@ -175,26 +243,27 @@ namespace th {
 					if (stats.power < MAX_POWER) {
 						stbsp_snprintf(buf, sizeof(buf), "%d", stats.power);
 					}
-					DrawTextBitmap(renderer, game.assets.fntMain, buf, rect.x, rect.y);
+					batch.DrawTextBitmap(game.assets.fntMain, buf, rect.x, rect.y);
 				}
 				// graze
 				{
 					char buf[10];
 					stbsp_snprintf(buf, sizeof(buf), "%d", stats.graze);
-					DrawTextBitmap(renderer, game.assets.fntMain, buf, x, y + 7 * 16);
+					batch.DrawTextBitmap(game.assets.fntMain, buf, x, y + 7 * 16);
 				}
 				// points
 				{
 					char buf[10];
 					int next = GetNextPointLevel(stats.points);
 					stbsp_snprintf(buf, sizeof(buf), "%d/%d", stats.points, next);
-					DrawTextBitmap(renderer, game.assets.fntMain, buf, x, y + 8 * 16);
+					batch.DrawTextBitmap(game.assets.fntMain, buf, x, y + 8 * 16);
 				}
 			}
 
 			// logo
 			{
-				SDL_Texture* texture = game.assets.GetTexture("Logo.png");
+				batch.Flush();
+				SDL_Texture* texture = game.assets.GetTexture(TEX_LOGO);
 				SDL_SetTextureScaleMode(texture, SDL_ScaleModeLinear);
 				SDL_Rect dest;
 				dest.x = PLAY_AREA_X + PLAY_AREA_W + 1 * 16;
@@ -207,50 +276,52 @@ namespace th {
 
 			// bottom enemy label
 			if (stage->boss_exists) {
-				SpriteData* sprite = game.assets.GetSprite("EnemyLabel");
+				SpriteData* sprite = game.assets.GetSprite(SPR_ENEMY_LABEL);
 				float x = (float)PLAY_AREA_X + std::clamp(stage->boss.x, (float)sprite->width / 2.0f, (float)PLAY_AREA_W - (float)sprite->width / 2.0f);
 				float y = (float)PLAY_AREA_Y + (float)PLAY_AREA_H;
-				DrawSprite(renderer, sprite, 0, x, y);
+				batch.DrawSprite(sprite, 0, x, y);
 			}
 
 			// DEBUG
 			if (game.show_debug) {
-				char buf[200];
-				stbsp_snprintf(
+				char buf[512];
+				int len = stbsp_snprintf(
 					buf,
 					sizeof(buf),
-					"Next ID %d\n"
-					"Lua Mem %fKb\n"
+					"Slots %d/%d\n"
+					"Lua Mem %fKb (arena %dKb)\n"
 					"Bullets %d (cap %d)\n"
 					"Enemies %d (cap %d)\n"
 					"Pickups %d (cap %d)\n"
-					"PlBullets %d (cap %d)",
-					stage->next_id,
+					"PlBullets %d (cap %d)\n"
+					"Grid cells %d tests %d\n"
+					"Threads %d pooled %d hit %d miss",
+					(int)stage->bullet_slots.slots.size(), (int)stage->enemy_slots.slots.size(),
 					(double)(lua_gc(stage->L, LUA_GCCOUNT) * 1024 + lua_gc(stage->L, LUA_GCCOUNTB)) / 1024.0,
+					(int)(game.lua_allocator.GetArenaBytes() / 1024),
 					(int)stage->bullets.size(), (int)stage->bullets.capacity(),
 					(int)stage->enemies.size(), (int)stage->enemies.capacity(),
 					(int)stage->pickups.size(), (int)stage->pickups.capacity(),
-					(int)stage->player_bullets.size(), (int)stage->player_bullets.capacity()
+					(int)stage->player_bullets.size(), (int)stage->player_bullets.capacity(),
+					stage->bullet_grid.cells_visited, stage->bullet_grid.narrowphase_tests,
+					(int)stage->coro_pool.size(), stage->coro_pool_hits, stage->coro_pool_misses
 				);
+				for (int i = 0; i < LUA_ALLOC_TYPE_COUNT && len < (int)sizeof(buf); i++) {
+					LuaAllocType type = (LuaAllocType)i;
+					len += stbsp_snprintf(buf + len, (int)sizeof(buf) - len, "\n  %s %d %.1fKb",
+										  LuaAllocator::GetTypeName(type),
+										  (int)game.lua_allocator.GetLiveCount(type),
+										  (double)game.lua_allocator.GetLiveBytes(type) / 1024.0);
+				}
 				int x = PLAY_AREA_X + PLAY_AREA_W + 16;
 				int y = PLAY_AREA_Y + 11 * 16;
 				//DrawTextBitmap(renderer, game.assets.fntMain, buf, x, y);
 
-				SDL_Surface* surface = TTF_RenderText_Blended_Wrapped(game.assets.fntCirno, buf, {255, 255, 255, 255}, 0);
-				SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-				{
-					SDL_SetTextureColorMod(texture, 0, 0, 0);
-					SDL_Rect dest{x + 1, y + 1, surface->w, surface->h};
-					SDL_RenderCopy(renderer, texture, nullptr, &dest);
-				}
-				{
-					SDL_SetTextureColorMod(texture, 192, 192, 255);
-					SDL_Rect dest{x, y, surface->w, surface->h};
-					SDL_RenderCopy(renderer, texture, nullptr, &dest);
-				}
-				SDL_DestroyTexture(texture);
-				SDL_FreeSurface(surface);
+				batch.DrawText(game.assets.fntCirnoGlyphs, buf, x + 1, y + 1, {0, 0, 0, 255});
+				batch.DrawText(game.assets.fntCirnoGlyphs, buf, x, y, {192, 192, 255, 255});
 			}
+
+			batch.Flush();
 		}
 	}
 
@@ -262,7 +333,7 @@ namespace th {
 		while (lives--) {
 			if (stats.lives < 8) {
 				stats.lives++;
-				PlaySound("se_extend.wav");
+				PlaySound(SND_EXTEND);
 			} else {
 				GetBombs(1);
 			}
@@ -290,7 +361,7 @@ namespace th {
 					case 80:
 					case 96:
 					case 128: {
-						PlaySound("se_powerup.wav");
+						PlaySound(SND_POWERUP);
 					}
 				}
 			}
@@ -37,6 +37,9 @@ namespace th {
 		void GetGraze(int graze);
 		void GetPoints(int points);
 
+		// hash of the state a replay has to reproduce
+		unsigned int GetChecksum();
+
 		Stats stats{};
 		std::optional<Stage> stage;
 
@@ -0,0 +1,132 @@
+#include "JobSystem.h"
+
+#include "common.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+namespace th {
+
+	bool JobSystem::Init(int thread_count) {
+		if (thread_count <= 0) {
+			thread_count = SDL_GetCPUCount();
+		}
+		worker_count = std::clamp(thread_count, 1, JOB_MAX_WORKERS);
+
+		if (worker_count == 1) {
+			return true;
+		}
+
+		start_sem = SDL_CreateSemaphore(0);
+		done_sem = SDL_CreateSemaphore(0);
+		if (!start_sem || !done_sem) {
+			TH_LOG_ERROR("couldn't create job semaphores: %s", SDL_GetError());
+			Shutdown();
+			return false;
+		}
+
+		SDL_AtomicSet(&next_worker_index, 1);
+		for (int i = 1; i < worker_count; i++) {
+			if (!(threads[i] = SDL_CreateThread(WorkerMain, "worker", this))) {
+				TH_LOG_ERROR("couldn't create worker thread: %s", SDL_GetError());
+				worker_count = i;
+				break;
+			}
+		}
+
+		return true;
+	}
+
+	void JobSystem::Shutdown() {
+		quit = true;
+		for (int i = 1; i < worker_count; i++) {
+			SDL_SemPost(start_sem);
+		}
+		for (int i = 1; i < worker_count; i++) {
+			SDL_WaitThread(threads[i], nullptr);
+			threads[i] = nullptr;
+		}
+		if (start_sem) SDL_DestroySemaphore(start_sem);
+		if (done_sem) SDL_DestroySemaphore(done_sem);
+		start_sem = nullptr;
+		done_sem = nullptr;
+		worker_count = 1;
+	}
+
+	void JobSystem::Run(size_t count, size_t chunk_size, JobFunc func, void* user) {
+		if (count == 0) return;
+
+		chunk_size = std::max(chunk_size, (size_t)1);
+		size_t chunks = (count + chunk_size - 1) / chunk_size;
+
+		if (worker_count == 1 || chunks == 1) {
+			func(user, 0, count, 0);
+			return;
+		}
+
+		job_func = func;
+		job_user = user;
+		job_count = count;
+		job_chunk_size = chunk_size;
+
+		for (int i = 0; i < worker_count; i++) {
+			SDL_AtomicSet(&queues[i].next, (int)(chunks * i / worker_count));
+			queues[i].end = (int)(chunks * (i + 1) / worker_count);
+		}
+
+		// the semaphores order the writes above before the workers' reads
+		for (int i = 1; i < worker_count; i++) {
+			SDL_SemPost(start_sem);
+		}
+
+		WorkLoop(0);
+
+		for (int i = 1; i < worker_count; i++) {
+			SDL_SemWait(done_sem);
+		}
+	}
+
+	void JobSystem::WorkLoop(int worker) {
+		for (;;) {
+			int chunk = -1;
+
+			// own queue first, then steal going around the others
+			for (int i = 0; i < worker_count; i++) {
+				Queue& queue = queues[(worker + i) % worker_count];
+				int c = SDL_AtomicAdd(&queue.next, 1);
+				if (c < queue.end) {
+					chunk = c;
+					break;
+				}
+			}
+
+			if (chunk < 0) {
+				return;
+			}
+
+			size_t begin = (size_t)chunk * job_chunk_size;
+			size_t end = std::min(begin + job_chunk_size, job_count);
+			TH_PROFILE_SCOPE("job");
+			job_func(job_user, begin, end, worker);
+		}
+	}
+
+	int JobSystem::WorkerMain(void* data) {
+		JobSystem* jobs = (JobSystem*)data;
+		int worker = SDL_AtomicAdd(&jobs->next_worker_index, 1);
+
+		TH_PROFILE_THREAD("worker");
+
+		for (;;) {
+			SDL_SemWait(jobs->start_sem);
+			if (jobs->quit) {
+				break;
+			}
+			jobs->WorkLoop(worker);
+			SDL_SemPost(jobs->done_sem);
+		}
+
+		return 0;
+	}
+
+}
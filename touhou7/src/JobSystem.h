@@ -0,0 +1,59 @@
+#pragma once
+
+#include <SDL.h>
+
+#include <stddef.h>
+
+#define JOB_MAX_WORKERS 32
+
+namespace th {
+
+	// Fork-join scheduler for data-parallel loops. A ParallelFor splits its
+	// range into chunks which are dealt out evenly to the workers' queues;
+	// a worker that runs out of chunks steals from the others. The calling
+	// thread is worker 0, so one worker means everything runs inline.
+	class JobSystem {
+	public:
+		bool Init(int thread_count); // 0: one worker per cpu core
+		void Shutdown();
+
+		int GetWorkerCount() const { return worker_count; }
+
+		// Calls f(begin, end, worker) for chunks of [0, count) and returns when
+		// all of them are done. `worker` indexes per-worker scratch buffers.
+		template <typename F>
+		void ParallelFor(size_t count, size_t chunk_size, const F& f) {
+			Run(count, chunk_size, [](void* user, size_t begin, size_t end, int worker) {
+				(*(const F*)user)(begin, end, worker);
+			}, (void*)&f);
+		}
+
+	private:
+		typedef void (*JobFunc)(void* user, size_t begin, size_t end, int worker);
+
+		struct Queue {
+			SDL_atomic_t next; // next chunk, taken by the owner and by thieves alike
+			int end;
+			char pad[64 - sizeof(SDL_atomic_t) - sizeof(int)];
+		};
+
+		void Run(size_t count, size_t chunk_size, JobFunc func, void* user);
+		void WorkLoop(int worker);
+		static int WorkerMain(void* data);
+
+		int worker_count = 1;
+		SDL_Thread* threads[JOB_MAX_WORKERS]{};
+		Queue queues[JOB_MAX_WORKERS]{};
+		SDL_sem* start_sem = nullptr;
+		SDL_sem* done_sem = nullptr;
+		SDL_atomic_t next_worker_index{};
+		bool quit = false;
+
+		// the current job
+		JobFunc job_func = nullptr;
+		void* job_user = nullptr;
+		size_t job_count = 0;
+		size_t job_chunk_size = 0;
+	};
+
+}
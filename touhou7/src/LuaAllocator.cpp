@@ -0,0 +1,160 @@
+#include "LuaAllocator.h"
+
+#include <lua.hpp>
+
+#include <iterator>
+#include <stdlib.h>
+#include <string.h>
+
+namespace th {
+
+	// block sizes, header included
+	static constexpr unsigned int class_sizes[] = {32, 48, 64, 80, 96, 128, 160, 192, 256, 320, 384, 512};
+
+	static unsigned char GetSizeClass(size_t block_size) {
+		for (unsigned char i = 0; i < (unsigned char)std::size(class_sizes); i++) {
+			if (block_size <= class_sizes[i]) {
+				return i;
+			}
+		}
+		return 0xFF; // LuaAllocator::LARGE
+	}
+
+	// when Lua allocates a new object, osize is its type instead of a size
+	static LuaAllocType GetAllocType(size_t tag) {
+		switch (tag) {
+			case LUA_TSTRING:   return LUA_ALLOC_STRING;
+			case LUA_TTABLE:    return LUA_ALLOC_TABLE;
+			case LUA_TFUNCTION: return LUA_ALLOC_FUNCTION;
+			case LUA_TUSERDATA: return LUA_ALLOC_USERDATA;
+			case LUA_TTHREAD:   return LUA_ALLOC_THREAD;
+		}
+		return LUA_ALLOC_OTHER;
+	}
+
+	const char* LuaAllocator::GetTypeName(LuaAllocType type) {
+		switch (type) {
+			case LUA_ALLOC_STRING:   return "string";
+			case LUA_ALLOC_TABLE:    return "table";
+			case LUA_ALLOC_FUNCTION: return "function";
+			case LUA_ALLOC_USERDATA: return "userdata";
+			case LUA_ALLOC_THREAD:   return "thread";
+			default:                 return "other";
+		}
+	}
+
+	void* LuaAllocator::Alloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+		LuaAllocator* self = (LuaAllocator*)ud;
+
+		if (!ptr) {
+			return (nsize > 0) ? self->Allocate(nsize, GetAllocType(osize)) : nullptr;
+		}
+
+		Header* header = (Header*)ptr - 1;
+		LuaAllocType type = (LuaAllocType)header->type;
+
+		if (nsize == 0) {
+			self->Free(header);
+			return nullptr;
+		}
+
+		unsigned char size_class = GetSizeClass(sizeof(Header) + nsize);
+
+		// still fits the same class, nothing moves
+		if (size_class == header->size_class && size_class != LARGE) {
+			self->live_bytes[type] += nsize - header->size;
+			header->size = (unsigned int)nsize;
+			return ptr;
+		}
+
+		if (size_class == LARGE && header->size_class == LARGE) {
+			Header* moved = (Header*)realloc(header, sizeof(Header) + nsize);
+			if (!moved) {
+				return nullptr;
+			}
+			self->live_bytes[type] += nsize - moved->size;
+			moved->size = (unsigned int)nsize;
+			return moved + 1;
+		}
+
+		void* result = self->Allocate(nsize, type);
+		if (!result) {
+			return nullptr;
+		}
+		memcpy(result, ptr, (osize < nsize) ? osize : nsize);
+		self->Free(header);
+		return result;
+	}
+
+	void* LuaAllocator::Allocate(size_t size, LuaAllocType type) {
+		size_t block_size = sizeof(Header) + size;
+		unsigned char size_class = GetSizeClass(block_size);
+
+		Header* header;
+		if (size_class == LARGE) {
+			header = (Header*)malloc(block_size);
+			if (!header) {
+				return nullptr;
+			}
+		} else if (FreeBlock* block = free_lists[size_class]) {
+			free_lists[size_class] = block->next;
+			header = (Header*)block;
+		} else {
+			size_t class_size = class_sizes[size_class];
+			if ((size_t)(chunk_end - chunk_cursor) < class_size) {
+				char* chunk = (char*)malloc(CHUNK_SIZE);
+				if (!chunk) {
+					return nullptr;
+				}
+				chunks.push_back(chunk);
+				chunk_cursor = chunk;
+				chunk_end = chunk + CHUNK_SIZE;
+			}
+			header = (Header*)chunk_cursor;
+			chunk_cursor += class_size;
+		}
+
+		header->size = (unsigned int)size;
+		header->size_class = size_class;
+		header->type = (unsigned char)type;
+
+		live_bytes[type] += size;
+		live_count[type]++;
+		return header + 1;
+	}
+
+	void LuaAllocator::Free(Header* header) {
+		live_bytes[header->type] -= header->size;
+		live_count[header->type]--;
+
+		unsigned char size_class = header->size_class;
+		if (size_class == LARGE) {
+			free(header);
+			return;
+		}
+
+		// the link overwrites the header
+		FreeBlock* block = (FreeBlock*)header;
+		block->next = free_lists[size_class];
+		free_lists[size_class] = block;
+	}
+
+	void LuaAllocator::Release() {
+		for (void* chunk : chunks) {
+			free(chunk);
+		}
+		chunks.clear();
+		chunk_cursor = nullptr;
+		chunk_end = nullptr;
+
+		for (FreeBlock*& list : free_lists) {
+			list = nullptr;
+		}
+
+		for (int i = 0; i < LUA_ALLOC_TYPE_COUNT; i++) {
+			live_bytes[i] = 0;
+			live_count[i] = 0;
+		}
+	}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+namespace th {
+
+	enum LuaAllocType {
+		LUA_ALLOC_STRING,
+		LUA_ALLOC_TABLE,
+		LUA_ALLOC_FUNCTION,
+		LUA_ALLOC_USERDATA,
+		LUA_ALLOC_THREAD,
+		LUA_ALLOC_OTHER, // upvalues, prototypes, arrays, stacks
+
+		LUA_ALLOC_TYPE_COUNT
+	};
+
+	// lua_Alloc for the game's Lua state. Small blocks come from free lists
+	// per size class, carved out of big chunks that are only given back by
+	// Release, after lua_close. Larger blocks go to malloc.
+	// Every block has a header with its size class and the type Lua gave when
+	// allocating it, so live bytes can be counted per type.
+	class LuaAllocator {
+	public:
+		LuaAllocator() = default;
+		LuaAllocator(const LuaAllocator&) = delete;
+		LuaAllocator& operator=(const LuaAllocator&) = delete;
+		~LuaAllocator() { Release(); }
+
+		// pass `this` as the ud
+		static void* Alloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+		void Release();
+
+		size_t GetLiveBytes(LuaAllocType type) const { return live_bytes[type]; }
+		size_t GetLiveCount(LuaAllocType type) const { return live_count[type]; }
+		size_t GetArenaBytes() const { return chunks.size() * CHUNK_SIZE; }
+
+		static const char* GetTypeName(LuaAllocType type);
+
+	private:
+		static constexpr size_t CHUNK_SIZE = 64 * 1024;
+		static constexpr int CLASS_COUNT = 12;
+		static constexpr unsigned char LARGE = 0xFF; // size_class of malloc'd blocks
+
+		struct alignas(16) Header {
+			unsigned int size; // what Lua asked for
+			unsigned char size_class;
+			unsigned char type;
+		};
+
+		struct FreeBlock {
+			FreeBlock* next;
+		};
+
+		void* Allocate(size_t size, LuaAllocType type);
+		void Free(Header* header);
+
+		std::vector<void*> chunks;
+		char* chunk_cursor = nullptr;
+		char* chunk_end = nullptr;
+		FreeBlock* free_lists[CLASS_COUNT] = {};
+
+		size_t live_bytes[LUA_ALLOC_TYPE_COUNT] = {};
+		size_t live_count[LUA_ALLOC_TYPE_COUNT] = {};
+	};
+
+}
@@ -2,11 +2,23 @@
 
 #include "Assets.h"
 
+#include "cpml.h"
+
 #include <lua.hpp>
 
+#include <algorithm>
+#include <vector>
+
 #define TYPE_PART_SHIFT 28
 #define ID_PART_MASK 0x0FFF'FFFF
 
+// the id part of an instance_id is a slot index and a generation (see SlotMap)
+#define SLOT_INDEX_BITS 16
+#define SLOT_INDEX_MASK 0xFFFF
+#define SLOT_GENERATION_MASK 0x0FFF
+#define SLOT_NONE 0xFFFF'FFFF
+#define SLOT_CAPACITY SLOT_INDEX_MASK // the last index is never handed out, ids with it don't resolve
+
 namespace th {
 
 	enum ObjectType : unsigned char {
@@ -18,6 +30,107 @@ namespace th {
 
 	typedef unsigned int instance_id;
 
+	typedef ptrdiff_t ssize;
+
+	// Maps instance ids to rows of a dense array which is compacted once a
+	// frame. A slot remembers the row of its object; freeing a slot
+	// bumps its generation so that stale ids no longer resolve. Free slots are
+	// reused oldest first, which keeps generations from wrapping quickly.
+	struct SlotMap {
+		struct Slot {
+			unsigned int row; // next free slot while not alive
+			unsigned short generation;
+			bool alive;
+		};
+
+		std::vector<Slot> slots;
+		unsigned int free_head = SLOT_NONE;
+		unsigned int free_tail = SLOT_NONE;
+
+		// Add can't be called once this is true, more slots would spill into the generation bits
+		bool IsFull() const { return free_head == SLOT_NONE && slots.size() >= SLOT_CAPACITY; }
+
+		// an id of `type` that never resolves
+		static instance_id NoneId(ObjectType type) { return SLOT_INDEX_MASK | ((instance_id)type << TYPE_PART_SHIFT); }
+
+		instance_id Add(ObjectType type, size_t row) {
+			unsigned int index;
+			if (free_head != SLOT_NONE) {
+				index = free_head;
+				free_head = slots[index].row;
+				if (free_head == SLOT_NONE) {
+					free_tail = SLOT_NONE;
+				}
+			} else {
+				index = (unsigned int)slots.size();
+				if (index >= SLOT_CAPACITY) {
+					return NoneId(type);
+				}
+				slots.push_back({});
+			}
+
+			Slot& slot = slots[index];
+			slot.row = (unsigned int)row;
+			slot.alive = true;
+			return index | ((instance_id)slot.generation << SLOT_INDEX_BITS) | ((instance_id)type << TYPE_PART_SHIFT);
+		}
+
+		ssize Find(instance_id id) const {
+			unsigned int index = id & SLOT_INDEX_MASK;
+			unsigned int generation = (id & ID_PART_MASK) >> SLOT_INDEX_BITS;
+			if (index >= slots.size()) {
+				return -1;
+			}
+			const Slot& slot = slots[index];
+			if (!slot.alive || slot.generation != generation) {
+				return -1;
+			}
+			return (ssize)slot.row;
+		}
+
+		void Move(instance_id id, size_t row) {
+			slots[id & SLOT_INDEX_MASK].row = (unsigned int)row;
+		}
+
+		void Remove(instance_id id) {
+			unsigned int index = id & SLOT_INDEX_MASK;
+			Slot& slot = slots[index];
+			slot.alive = false;
+			slot.generation = (slot.generation + 1) & SLOT_GENERATION_MASK;
+			slot.row = SLOT_NONE;
+			if (free_tail != SLOT_NONE) {
+				slots[free_tail].row = index;
+			} else {
+				free_head = index;
+			}
+			free_tail = index;
+		}
+
+		// frees every live slot; generations are kept so old ids stay stale
+		void Clear() {
+			for (size_t i = 0; i < slots.size(); i++) {
+				if (slots[i].alive) {
+					Remove((instance_id)i);
+				}
+			}
+		}
+	};
+
+	// removes the elements flagged in `remove` in one pass, keeping the order of the rest
+	template <typename T>
+	void CompactColumn(std::vector<T>& v, const unsigned char* remove) {
+		size_t w = 0;
+		for (size_t i = 0, n = v.size(); i < n; i++) {
+			if (!remove[i]) {
+				if (w != i) {
+					v[w] = std::move(v[i]);
+				}
+				w++;
+			}
+		}
+		v.erase(v.begin() + w, v.end());
+	}
+
 	struct SpriteComponent {
 		SpriteData* sprite;
 		float frame_index;
@@ -70,10 +183,14 @@ namespace th {
 	};
 
 	struct PlayerBullet {
+		bool dead;
+
 		float x;
 		float y;
 		float spd;
 		float dir;
+		float ux; // lengthdir_x(1, dir), written by SetDir
+		float uy; // lengthdir_y(1, dir)
 		float acc;
 		float radius;
 		SpriteComponent sc;
@@ -91,22 +208,13 @@ namespace th {
 		SLazer
 	};
 
+	// The cold part of a bullet: what scripts and drawing need. Id, position,
+	// motion and collision radius are stored in BulletArray columns.
 	struct Bullet {
-		instance_id id;
 		bool dead;
 
-		float x;
-		float y;
-		float spd;
-		float dir;
-		float acc;
-
-		ProjectileType type;
 		union {
-			struct {
-				float radius;
-				bool rotate;
-			};
+			bool rotate;
 			struct {
 				float length;
 				float thickness;
@@ -114,17 +222,159 @@ namespace th {
 				float lazer_time;
 				float lazer_timer;
 				float lazer_lifetime;
+
+				// shape cache, see BulletArray::UpdateLazerShape
+				float center_dx; // rect center relative to x, y
+				float center_dy;
+				float extent_x; // half size of the world aabb
+				float extent_y;
 			};
 		};
 
 		SpriteComponent sc;
-		float lifetime;
 		bool grazed;
 
 		int coroutine = LUA_REFNIL;
+		unsigned int coro_wake = 0; // see Stage::ScheduleCoroutine
 		int update_callback = LUA_REFNIL;
 	};
 
+	// Bullets are stored as a structure of arrays, so that the physics loops
+	// stream through contiguous floats instead of whole Bullet structs.
+	// Row i of every column belongs to the same bullet; rows are found by id
+	// through Stage::bullet_slots.
+	struct BulletArray {
+		std::vector<instance_id> id;
+		std::vector<ProjectileType> type;
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> spd;
+		std::vector<float> dir;
+		std::vector<float> acc;
+		std::vector<float> radius;
+		std::vector<float> lifetime;
+		std::vector<float> ux; // lengthdir_x(1, dir), written by SetDir
+		std::vector<float> uy; // lengthdir_y(1, dir)
+		std::vector<unsigned int> move; // ~0 if the bullet moves this frame, see UpdateMove
+		std::vector<Bullet> data;
+
+		size_t size() const { return id.size(); }
+		size_t capacity() const { return id.capacity(); }
+
+		size_t IndexOf(const Bullet* bullet) const { return (size_t)(bullet - data.data()); }
+
+		// room for count more bullets, growing geometrically so that calling
+		// it per volley doesn't reallocate every time
+		void Reserve(size_t count) {
+			size_t needed = size() + count;
+			if (needed <= capacity()) {
+				return;
+			}
+			needed = std::max(needed, capacity() * 2);
+			id.reserve(needed);
+			type.reserve(needed);
+			x.reserve(needed);
+			y.reserve(needed);
+			spd.reserve(needed);
+			dir.reserve(needed);
+			acc.reserve(needed);
+			radius.reserve(needed);
+			lifetime.reserve(needed);
+			ux.reserve(needed);
+			uy.reserve(needed);
+			move.reserve(needed);
+			data.reserve(needed);
+		}
+
+		size_t Add(instance_id new_id) {
+			id.push_back(new_id);
+			type.push_back(ProjectileType::Bullet);
+			x.push_back(0.0f);
+			y.push_back(0.0f);
+			spd.push_back(0.0f);
+			dir.push_back(0.0f);
+			acc.push_back(0.0f);
+			radius.push_back(0.0f);
+			lifetime.push_back(0.0f);
+			ux.push_back(0.0f);
+			uy.push_back(0.0f);
+			move.push_back(~0u);
+			data.emplace_back();
+			SetDir(id.size() - 1, 0.0f);
+			return id.size() - 1;
+		}
+
+		// Stage::Update refreshes this every frame, spawns call it so a
+		// bullet made during physics moves in the rest of it
+		void UpdateMove(size_t i) {
+			bool moves = true;
+			if (type[i] == ProjectileType::Lazer || type[i] == ProjectileType::SLazer) {
+				// lasers stay in place until fully extended
+				moves = (data[i].lazer_timer >= data[i].lazer_time);
+			}
+			move[i] = moves ? ~0u : 0u;
+		}
+
+		void SetDir(size_t i, float value) {
+			dir[i] = value;
+			ux[i] = cpml::lengthdir_x(1.0f, value);
+			uy[i] = cpml::lengthdir_y(1.0f, value);
+			if (type[i] == ProjectileType::Lazer || type[i] == ProjectileType::SLazer) {
+				UpdateLazerShape(i);
+			}
+		}
+
+		// call when a laser's dir, length or thickness changes
+		void UpdateLazerShape(size_t i) {
+			Bullet& bullet = data[i];
+			bullet.center_dx = bullet.length / 2.0f * ux[i];
+			bullet.center_dy = bullet.length / 2.0f * uy[i];
+			bullet.extent_x = fabsf(bullet.center_dx) + fabsf(uy[i]) * bullet.thickness / 2.0f;
+			bullet.extent_y = fabsf(bullet.center_dy) + fabsf(ux[i]) * bullet.thickness / 2.0f;
+		}
+
+		// removes the flagged rows, column by column
+		void Compact(const unsigned char* remove) {
+			CompactColumn(id, remove);
+			CompactColumn(type, remove);
+			CompactColumn(x, remove);
+			CompactColumn(y, remove);
+			CompactColumn(spd, remove);
+			CompactColumn(dir, remove);
+			CompactColumn(acc, remove);
+			CompactColumn(radius, remove);
+			CompactColumn(lifetime, remove);
+			CompactColumn(ux, remove);
+			CompactColumn(uy, remove);
+			CompactColumn(move, remove);
+			CompactColumn(data, remove);
+		}
+
+		void Clear() {
+			id.clear();
+			type.clear();
+			x.clear();
+			y.clear();
+			spd.clear();
+			dir.clear();
+			acc.clear();
+			radius.clear();
+			lifetime.clear();
+			ux.clear();
+			uy.clear();
+			move.clear();
+			data.clear();
+		}
+	};
+
+	// Movement uses the cached unit direction, so dir must not be written directly.
+	template <typename Object>
+	inline void SetDir(Object& object, float value) {
+		object.dir = value;
+		object.ux = cpml::lengthdir_x(1.0f, value);
+		object.uy = cpml::lengthdir_y(1.0f, value);
+	}
+
 	struct Enemy {
 		instance_id id;
 		bool dead;
@@ -133,6 +383,8 @@ namespace th {
 		float y;
 		float spd;
 		float dir;
+		float ux; // lengthdir_x(1, dir), written by SetDir
+		float uy; // lengthdir_y(1, dir)
 		float acc;
 		float radius;
 		SpriteComponent sc;
@@ -141,6 +393,7 @@ namespace th {
 		unsigned int drops;
 
 		int coroutine = LUA_REFNIL;
+		unsigned int coro_wake = 0;
 		int update_callback = LUA_REFNIL;
 		int death_callback = LUA_REFNIL;
 	};
@@ -159,6 +412,8 @@ namespace th {
 		float y;
 		float spd;
 		float dir;
+		float ux; // lengthdir_x(1, dir), written by SetDir
+		float uy; // lengthdir_y(1, dir)
 		float acc;
 		float radius;
 		SpriteComponent sc;
@@ -171,6 +426,7 @@ namespace th {
 		float facing = 1.0f;
 
 		int coroutine = LUA_REFNIL;
+		unsigned int coro_wake = 0;
 	};
 
 	enum {
@@ -187,6 +443,8 @@ namespace th {
 	};
 
 	struct Pickup {
+		bool dead;
+
 		float x;
 		float y;
 		float hsp;
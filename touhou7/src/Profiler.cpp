@@ -0,0 +1,126 @@
+#include "Profiler.h"
+
+#if TH_PROFILE
+
+#include "common.h"
+#include "external/stb_sprintf.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace th {
+
+	struct ProfileSample {
+		const char* name;
+		Uint64 start;
+		Uint64 end;
+	};
+
+	struct ProfileRing {
+		const char* thread_name;
+		int tid;
+		Uint64 count; // total samples written, the ring holds the last ones
+		ProfileSample samples[TH_PROFILE_RING_SIZE];
+	};
+
+	static ProfileRing* rings[TH_PROFILE_MAX_THREADS];
+	static SDL_atomic_t ring_count;
+	static Uint64 profiler_start;
+
+	static thread_local ProfileRing* thread_ring;
+	static thread_local bool thread_ring_full;
+
+	static ProfileRing* GetThreadRing() {
+		if (!thread_ring && !thread_ring_full) {
+			int index = SDL_AtomicAdd(&ring_count, 1);
+			if (index < TH_PROFILE_MAX_THREADS) {
+				ProfileRing* ring = new ProfileRing;
+				ring->thread_name = nullptr;
+				ring->tid = index;
+				ring->count = 0;
+				rings[index] = ring;
+				thread_ring = ring;
+			} else {
+				thread_ring_full = true;
+			}
+		}
+		return thread_ring;
+	}
+
+	void InitProfiler() {
+		profiler_start = SDL_GetPerformanceCounter();
+		SetProfilerThreadName("main");
+	}
+
+	void ShutdownProfiler() {
+		int count = std::min(SDL_AtomicGet(&ring_count), TH_PROFILE_MAX_THREADS);
+		for (int i = 0; i < count; i++) {
+			delete rings[i];
+			rings[i] = nullptr;
+		}
+		SDL_AtomicSet(&ring_count, 0);
+		thread_ring = nullptr;
+	}
+
+	void SetProfilerThreadName(const char* name) {
+		if (ProfileRing* ring = GetThreadRing()) {
+			ring->thread_name = name;
+		}
+	}
+
+	void RecordProfileSample(const char* name, Uint64 start, Uint64 end) {
+		ProfileRing* ring = GetThreadRing();
+		if (!ring) return;
+
+		ProfileSample& sample = ring->samples[ring->count % TH_PROFILE_RING_SIZE];
+		sample.name = name;
+		sample.start = start;
+		sample.end = end;
+		ring->count++;
+	}
+
+	bool WriteChromeTrace(const char* fname) {
+		std::ofstream file(fname);
+		if (!file) {
+			TH_LOG_ERROR("couldn't open %s for writing", fname);
+			return false;
+		}
+
+		double us_per_tick = 1'000'000.0 / (double)SDL_GetPerformanceFrequency();
+
+		char buf[256];
+		file << "{\"traceEvents\":[\n";
+		bool first = true;
+
+		int count = std::min(SDL_AtomicGet(&ring_count), TH_PROFILE_MAX_THREADS);
+		for (int i = 0; i < count; i++) {
+			ProfileRing* ring = rings[i];
+			if (!ring) continue;
+
+			char default_name[16];
+			const char* thread_name = ring->thread_name;
+			if (!thread_name) {
+				stbsp_snprintf(default_name, sizeof(default_name), "thread %d", ring->tid);
+				thread_name = default_name;
+			}
+			stbsp_snprintf(buf, sizeof(buf), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", ring->tid, thread_name);
+			file << buf;
+			first = false;
+
+			Uint64 begin = (ring->count > TH_PROFILE_RING_SIZE) ? ring->count - TH_PROFILE_RING_SIZE : 0;
+			for (Uint64 j = begin; j < ring->count; j++) {
+				const ProfileSample& sample = ring->samples[j % TH_PROFILE_RING_SIZE];
+				double ts = (double)(sample.start - profiler_start) * us_per_tick;
+				double dur = (double)(sample.end - sample.start) * us_per_tick;
+				stbsp_snprintf(buf, sizeof(buf), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", sample.name, ring->tid, ts, dur);
+				file << buf;
+			}
+		}
+
+		file << "\n]}\n";
+		return (bool)file;
+	}
+
+}
+
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <SDL.h>
+
+// Build with TH_PROFILE=0 to compile the markers out entirely.
+#ifndef TH_PROFILE
+#define TH_PROFILE 1
+#endif
+
+// samples kept per thread, older ones are overwritten
+#define TH_PROFILE_RING_SIZE 65536
+
+#define TH_PROFILE_MAX_THREADS 64
+
+namespace th {
+
+#if TH_PROFILE
+
+	// Scoped cpu timing markers. Each thread writes its samples into its own
+	// ring buffer, so recording takes no locks. Nesting is implied by the
+	// time ranges, the trace viewer rebuilds the hierarchy from them.
+	// Marker names have to outlive the profiler, use string literals.
+	void InitProfiler();
+	void ShutdownProfiler();
+
+	void SetProfilerThreadName(const char* name);
+
+	void RecordProfileSample(const char* name, Uint64 start, Uint64 end);
+
+	// Chrome trace-event JSON, for chrome://tracing or Perfetto. Only call
+	// while no other thread is recording, e.g. between frames.
+	bool WriteChromeTrace(const char* fname);
+
+	class ProfileScope {
+	public:
+		ProfileScope(const char* name) : name(name), start(SDL_GetPerformanceCounter()) {}
+		~ProfileScope() { RecordProfileSample(name, start, SDL_GetPerformanceCounter()); }
+
+	private:
+		const char* name;
+		Uint64 start;
+	};
+
+#define TH_PROFILE_CONCAT_(a, b) a##b
+#define TH_PROFILE_CONCAT(a, b) TH_PROFILE_CONCAT_(a, b)
+#define TH_PROFILE_SCOPE(name) ::th::ProfileScope TH_PROFILE_CONCAT(_profile_scope_, __LINE__)(name)
+#define TH_PROFILE_THREAD(name) ::th::SetProfilerThreadName(name)
+
+#else
+
+	inline void InitProfiler() {}
+	inline void ShutdownProfiler() {}
+	inline bool WriteChromeTrace(const char* fname) { return false; }
+
+#define TH_PROFILE_SCOPE(name) ((void)0)
+#define TH_PROFILE_THREAD(name) ((void)0)
+
+#endif
+
+}
@@ -0,0 +1,156 @@
+#include "Replay.h"
+
+#include "common.h"
+
+#include <fstream>
+
+#define TH_REPLAY_MAGIC   0x52374854 // "TH7R"
+#define TH_REPLAY_VERSION 2
+
+namespace th {
+
+	template <typename T>
+	static void WriteValue(std::ofstream& file, const T& value) {
+		file.write((const char*)&value, sizeof(value));
+	}
+
+	template <typename T>
+	static bool ReadValue(std::ifstream& file, T* value) {
+		return (bool)file.read((char*)value, sizeof(*value));
+	}
+
+	void Replay::BeginRecording(const Header& _header) {
+		header = _header;
+		checksum = 0;
+		runs.clear();
+		frame_count = 0;
+		recording = true;
+		playing = false;
+	}
+
+	void Replay::Record(unsigned short input) {
+		if (!recording) return;
+
+		if (!runs.empty() && runs.back().input == input && runs.back().count < 0xFFFF) {
+			runs.back().count++;
+		} else {
+			runs.push_back({input, 1});
+		}
+		frame_count++;
+	}
+
+	bool Replay::Save(const std::string& fname, unsigned int _checksum) {
+		recording = false;
+		checksum = _checksum;
+
+		std::ofstream file(fname, std::ios::binary);
+		if (!file) {
+			TH_LOG_ERROR("couldn't open %s for writing", fname.c_str());
+			return false;
+		}
+
+		WriteValue(file, (unsigned int)TH_REPLAY_MAGIC);
+		WriteValue(file, (unsigned int)TH_REPLAY_VERSION);
+		WriteValue(file, (int)header.stage_index);
+		WriteValue(file, (int)header.player_character);
+		WriteValue(file, header.game_seed);
+		WriteValue(file, header.stage_seed);
+		WriteValue(file, (unsigned char)header.skip_to_midboss);
+		WriteValue(file, (unsigned char)header.skip_to_boss);
+		WriteValue(file, (unsigned char)header.substep_physics);
+		WriteValue(file, (unsigned int)frame_count);
+		WriteValue(file, checksum);
+		WriteValue(file, (unsigned int)runs.size());
+		for (const Run& run : runs) {
+			WriteValue(file, run.input);
+			WriteValue(file, run.count);
+		}
+
+		if (!file) {
+			TH_LOG_ERROR("couldn't write replay %s", fname.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	bool Replay::Load(const std::string& fname) {
+		std::ifstream file(fname, std::ios::binary);
+		if (!file) {
+			TH_LOG_ERROR("couldn't open replay %s", fname.c_str());
+			return false;
+		}
+
+		unsigned int magic = 0;
+		unsigned int version = 0;
+		unsigned char skip_to_midboss = 0;
+		unsigned char skip_to_boss = 0;
+		unsigned char substep_physics = 0;
+		unsigned int frames = 0;
+		unsigned int run_count = 0;
+
+		bool ok = ReadValue(file, &magic)
+			&& ReadValue(file, &version)
+			&& magic == TH_REPLAY_MAGIC
+			&& version == TH_REPLAY_VERSION
+			&& ReadValue(file, &header.stage_index)
+			&& ReadValue(file, &header.player_character)
+			&& ReadValue(file, &header.game_seed)
+			&& ReadValue(file, &header.stage_seed)
+			&& ReadValue(file, &skip_to_midboss)
+			&& ReadValue(file, &skip_to_boss)
+			&& ReadValue(file, &substep_physics)
+			&& ReadValue(file, &frames)
+			&& ReadValue(file, &checksum)
+			&& ReadValue(file, &run_count);
+		if (!ok) {
+			TH_LOG_ERROR("%s is not a replay of this version", fname.c_str());
+			return false;
+		}
+
+		header.skip_to_midboss = skip_to_midboss;
+		header.skip_to_boss = skip_to_boss;
+		header.substep_physics = substep_physics;
+
+		runs.resize(run_count);
+		int total = 0;
+		for (Run& run : runs) {
+			if (!ReadValue(file, &run.input) || !ReadValue(file, &run.count)) {
+				TH_LOG_ERROR("replay %s is truncated", fname.c_str());
+				return false;
+			}
+			total += run.count;
+		}
+		if (total != (int)frames) {
+			TH_LOG_ERROR("replay %s is corrupted", fname.c_str());
+			return false;
+		}
+		frame_count = total;
+
+		return true;
+	}
+
+	void Replay::BeginPlayback() {
+		playing = true;
+		recording = false;
+		run_index = 0;
+		run_frame = 0;
+	}
+
+	bool Replay::Next(unsigned short* input) {
+		if (!playing) return false;
+
+		while (run_index < runs.size() && run_frame >= runs[run_index].count) {
+			run_index++;
+			run_frame = 0;
+		}
+		if (run_index >= runs.size()) {
+			playing = false;
+			return false;
+		}
+
+		*input = runs[run_index].input;
+		run_frame++;
+		return true;
+	}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace th {
+
+	// gameplay input of one stage frame
+	enum : unsigned short {
+		INPUT_LEFT  = 1 << 0,
+		INPUT_RIGHT = 1 << 1,
+		INPUT_UP    = 1 << 2,
+		INPUT_DOWN  = 1 << 3,
+		INPUT_FOCUS = 1 << 4,
+		INPUT_SHOT  = 1 << 5,
+		INPUT_BOMB  = 1 << 6,
+
+		// debug keys that change the game state
+		INPUT_DEBUG_POWER     = 1 << 7,
+		INPUT_DEBUG_END_PHASE = 1 << 8,
+	};
+
+	// The input of every stage frame of one game scene plus what is needed
+	// to start the scene the same way again. Inputs are stored as runs of
+	// equal frames. The checksum of the final state is saved with the
+	// inputs so a playback can tell whether it reproduced the run.
+	class Replay {
+	public:
+		struct Header {
+			int stage_index;
+			int player_character;
+			unsigned long long game_seed;
+			unsigned long long stage_seed;
+			bool skip_to_midboss;
+			bool skip_to_boss;
+			bool substep_physics; // moves and collides bullets differently
+		};
+
+		void BeginRecording(const Header& header);
+		void Record(unsigned short input);
+		bool Save(const std::string& fname, unsigned int checksum);
+
+		bool Load(const std::string& fname);
+		void BeginPlayback();
+		bool Next(unsigned short* input); // false once all frames are played
+
+		bool IsRecording() const { return recording; }
+		bool IsPlaying() const { return playing; }
+		int GetFrameCount() const { return frame_count; }
+
+		Header header{};
+		unsigned int checksum = 0;
+
+	private:
+		struct Run {
+			unsigned short input;
+			unsigned short count;
+		};
+
+		std::vector<Run> runs;
+		int frame_count = 0;
+
+		bool recording = false;
+		bool playing = false;
+		size_t run_index = 0;
+		int run_frame = 0;
+	};
+
+}
@@ -26,6 +26,13 @@ namespace th {
 		return ctx;
 	}
 
+	// Hot functions are closures (see lua_register_closure): upvalue 1 is the
+	// Game, the rest are the keys of their table argument in positional
+	// order, interned once at registration instead of on every call.
+	static Game* lua_upcontext(lua_State* L) {
+		return (Game*)lua_touserdata(L, lua_upvalueindex(1));
+	}
+
 	static int lua_random(lua_State* L) {
 		lua_checkargc(L, 0, 2);
 
@@ -41,185 +48,358 @@ namespace th {
 			}
 		}
 
-		Game* ctx = lua_getcontext(L);
+		Game* ctx = lua_upcontext(L);
 		float r = ctx->game_scene->stage->random.range(a, b);
 		lua_pushnumber(L, (lua_Number) r);
 
 		return 1;
 	}
 
-	static float lua_named_argf(lua_State* L, int argc, int i, const char* name, float def = 0.0f) {
-		float res = def;
+	// pushes the i-th table arg, by position or by key
+	static int lua_named_arg(lua_State* L, int argc, int i) {
 		if (argc >= i) {
-			lua_geti(L, 1, i);
+			return lua_rawgeti(L, 1, i);
+		}
+		lua_pushvalue(L, lua_upvalueindex(1 + i));
+		return lua_rawget(L, 1);
+	}
+
+	static float lua_named_argf(lua_State* L, int argc, int i, float def = 0.0f) {
+		float res = def;
+		if (lua_named_arg(L, argc, i) != LUA_TNIL || argc >= i) {
 			res = (float)luaL_checknumber(L, -1);
-			lua_pop(L, 1);
-		} else {
-			lua_getfield(L, 1, name);
-			if (!lua_isnil(L, -1)) {
-				res = (float)luaL_checknumber(L, -1);
-			}
-			lua_pop(L, 1);
 		}
+		lua_pop(L, 1);
 		return res;
 	}
 
-	static int lua_named_argi(lua_State* L, int argc, int i, const char* name, int def = 0) {
+	static int lua_named_argi(lua_State* L, int argc, int i, int def = 0) {
 		int res = def;
-		if (argc >= i) {
-			lua_geti(L, 1, i);
+		if (lua_named_arg(L, argc, i) != LUA_TNIL || argc >= i) {
 			res = (int)luaL_checkinteger(L, -1);
-			lua_pop(L, 1);
-		} else {
-			lua_getfield(L, 1, name);
-			if (!lua_isnil(L, -1)) {
-				res = (int)luaL_checkinteger(L, -1);
-			}
-			lua_pop(L, 1);
 		}
+		lua_pop(L, 1);
 		return res;
 	}
 
-	static const char* lua_named_argstr(lua_State* L, int argc, int i, const char* name, const char* def = nullptr) {
+	static const char* lua_named_argstr(lua_State* L, int argc, int i, const char* def = nullptr) {
 		const char* res = def;
-		if (argc >= i) {
-			lua_geti(L, 1, i);
+		if (lua_named_arg(L, argc, i) != LUA_TNIL || argc >= i) {
 			res = luaL_checkstring(L, -1);
-			lua_pop(L, 1);
-		} else {
-			lua_getfield(L, 1, name);
-			if (!lua_isnil(L, -1)) {
-				res = luaL_checkstring(L, -1);
-			}
-			lua_pop(L, 1);
 		}
+		lua_pop(L, 1);
 		return res;
 	}
 
-	static void* lua_named_argp(lua_State* L, int argc, int i, const char* name, void* def = nullptr) {
+	static void* lua_named_argp(lua_State* L, int argc, int i, void* def = nullptr) {
 		void* res = def;
-		if (argc >= i) {
-			lua_geti(L, 1, i);
+		if (lua_named_arg(L, argc, i) != LUA_TNIL || argc >= i) {
 			luaL_checktype(L, -1, LUA_TLIGHTUSERDATA);
 			res = lua_touserdata(L, -1);
-			lua_pop(L, 1);
-		} else {
-			lua_getfield(L, 1, name);
-			if (!lua_isnil(L, -1)) {
-				luaL_checktype(L, -1, LUA_TLIGHTUSERDATA);
-				res = lua_touserdata(L, -1);
-			}
-			lua_pop(L, 1);
 		}
+		lua_pop(L, 1);
 		return res;
 	}
 
-	static bool lua_named_argfunc(lua_State* L, int argc, int i, const char* name) {
-		bool res = false;
-		if (argc >= i) {
-			lua_geti(L, 1, i);
+	// leaves the function on the stack if there is one
+	static bool lua_named_argfunc(lua_State* L, int argc, int i) {
+		if (lua_named_arg(L, argc, i) != LUA_TNIL || argc >= i) {
 			luaL_checktype(L, -1, LUA_TFUNCTION);
-			res = true;
-		} else {
-			lua_getfield(L, 1, name);
-			if (!lua_isnil(L, -1)) {
-				luaL_checktype(L, -1, LUA_TFUNCTION);
-				res = true;
-			} else {
-				lua_pop(L, 1);
-			}
+			return true;
 		}
-		return res;
+		lua_pop(L, 1);
+		return false;
+	}
+
+	// same for the positional variants
+	static bool lua_argfunc(lua_State* L, int i) {
+		if (lua_isnoneornil(L, i)) {
+			return false;
+		}
+		luaL_checktype(L, i, LUA_TFUNCTION);
+		lua_pushvalue(L, i);
+		return true;
 	}
 
 	// @main_thread
-	int CreateCoroutine(lua_State* L, lua_State* main_L) {
-		if (lua_gettop(L) < 1) {
+	int Stage::CreateCoroutine(lua_State* from) {
+		if (lua_gettop(from) < 1) {
 			TH_LOG_ERROR("CreateCoroutine: stack is empty");
 			return LUA_REFNIL;
 		}
 
-		if (!lua_isfunction(L, -1)) {
+		if (!lua_isfunction(from, -1)) {
 			TH_LOG_ERROR("CreateCoroutine: not a function");
-			lua_pop(L, 1);
+			lua_pop(from, 1);
 			return LUA_REFNIL;
 		}
 
-		lua_State* NL = lua_newthread(main_L);
-		int coroutine = luaL_ref(main_L, LUA_REGISTRYINDEX);
-		lua_xmove(L, NL, 1);
+		lua_State* NL;
+		int coroutine;
+		if (!coro_pool.empty()) {
+			coroutine = coro_pool.back();
+			coro_pool.pop_back();
+			lua_rawgeti(L, LUA_REGISTRYINDEX, coroutine);
+			NL = lua_tothread(L, -1);
+			lua_pop(L, 1);
+			coro_pool_hits++;
+		} else {
+			NL = lua_newthread(L);
+			coroutine = luaL_ref(L, LUA_REGISTRYINDEX);
+			coro_pool_misses++;
+		}
+		lua_xmove(from, NL, 1);
 		return coroutine;
 	}
 
+	void Stage::FreeCoroutine(int coroutine) {
+		if (coroutine == LUA_REFNIL) {
+			return;
+		}
+
+		lua_rawgeti(L, LUA_REGISTRYINDEX, coroutine);
+		lua_State* NL = lua_tothread(L, -1);
+		lua_pop(L, 1);
+
+		// a coroutine that frees itself is still on the C stack and can't
+		// be reset, it's left to the gc
+		lua_Debug ar;
+		bool running = !NL || (lua_status(NL) == LUA_OK && lua_getstack(NL, 0, &ar));
+		if (running || coro_pool.size() >= COROUTINE_POOL_MAX) {
+			luaL_unref(L, LUA_REGISTRYINDEX, coroutine);
+			return;
+		}
+
+#if LUA_VERSION_RELEASE_NUM >= 50406
+		lua_closethread(NL, L);
+#else
+		lua_resetthread(NL);
+#endif
+		coro_pool.push_back(coroutine);
+	}
+
 	static int lua_getargc(lua_State* L) {
 		lua_checkargc(L, 1, 1);
 		luaL_checktype(L, 1, LUA_TTABLE);
 
-		lua_len(L, 1);
-		int argc = (int)lua_tointeger(L, -1);
-		lua_pop(L, 1);
+		return (int)lua_rawlen(L, 1);
+	}
 
-		return argc;
+	static instance_id SpawnEnemy(Game* ctx, float x, float y, float spd, float dir, float acc, void* spr, int drops, int coroutine, int death_callback, int update_callback) {
+		Stage& stage = *ctx->game_scene->stage;
+		Enemy* created = stage.CreateEnemy();
+		if (!created) {
+			stage.FreeCoroutine(coroutine);
+			if (death_callback != LUA_REFNIL) luaL_unref(stage.L, LUA_REGISTRYINDEX, death_callback);
+			if (update_callback != LUA_REFNIL) luaL_unref(stage.L, LUA_REGISTRYINDEX, update_callback);
+			return SlotMap::NoneId(TYPE_ENEMY);
+		}
+		Enemy& enemy = *created;
+		enemy.x = x;
+		enemy.y = y;
+		enemy.spd = spd;
+		SetDir(enemy, cpml::angle_wrap(dir));
+		enemy.acc = acc;
+		enemy.radius = 10.0f;
+		enemy.sc.sprite = (SpriteData*)spr;
+		enemy.hp = 10.0f;
+		enemy.drops = drops;
+		enemy.coroutine = coroutine;
+		if (coroutine != LUA_REFNIL) {
+			ctx->game_scene->stage->ScheduleCoroutine(enemy.id, &enemy.coro_wake, 0);
+		}
+		enemy.death_callback = death_callback;
+		enemy.update_callback = update_callback;
+		return enemy.id;
 	}
 
+	static instance_id SpawnBullet(Game* ctx, float x, float y, float spd, float dir, float acc, int type, int color, int coroutine, bool sound = true) {
+		BulletData* data = GetBulletData(type);
+
+		BulletArray& bullets = ctx->game_scene->stage->bullets;
+		Bullet* created = ctx->game_scene->stage->CreateBullet();
+		if (!created) {
+			ctx->game_scene->stage->FreeCoroutine(coroutine);
+			return SlotMap::NoneId(TYPE_BULLET);
+		}
+		Bullet& bullet = *created;
+		size_t index = bullets.IndexOf(&bullet);
+		bullets.x[index] = x;
+		bullets.y[index] = y;
+		bullets.spd[index] = spd;
+		bullets.SetDir(index, cpml::angle_wrap(dir));
+		bullets.acc[index] = acc;
+
+		bullets.type[index] = ProjectileType::Bullet;
+		bullets.radius[index] = data->radius;
+		bullet.rotate = data->rotate;
+
+		bullet.sc.sprite = data->sprite;
+		bullet.sc.frame_index = (float)color;
+		bullet.coroutine = coroutine;
+		if (coroutine != LUA_REFNIL) {
+			ctx->game_scene->stage->ScheduleCoroutine(bullets.id[index], &bullet.coro_wake, 0);
+		}
+
+		if (sound) {
+			PlaySound(SND_ENEMY_SHOOT);
+		}
+		return bullets.id[index];
+	}
+
+	static instance_id SpawnLazer(Game* ctx, float x, float y, float spd, float dir, float length, float thickness, int color, int coroutine) {
+		if (spd == 0.0f) spd = 1.0f;
+		if (length == 0.0f) length = 1.0f;
+		float time = length / spd;
+
+		BulletArray& bullets = ctx->game_scene->stage->bullets;
+		Bullet* created = ctx->game_scene->stage->CreateBullet();
+		if (!created) {
+			ctx->game_scene->stage->FreeCoroutine(coroutine);
+			return SlotMap::NoneId(TYPE_BULLET);
+		}
+		Bullet& bullet = *created;
+		size_t index = bullets.IndexOf(&bullet);
+		bullets.x[index] = x;
+		bullets.y[index] = y;
+		bullets.spd[index] = spd;
+		bullets.SetDir(index, cpml::angle_wrap(dir));
+
+		bullets.type[index] = ProjectileType::Lazer;
+		bullet.target_length = length;
+		bullet.thickness = thickness;
+		bullet.lazer_time = time;
+		bullets.UpdateLazerShape(index);
+		bullets.UpdateMove(index);
+
+		bullet.sc.sprite = ctx->assets.GetSprite(SPR_LAZER);
+		bullet.sc.frame_index = (float)color;
+		bullet.coroutine = coroutine;
+		if (coroutine != LUA_REFNIL) {
+			ctx->game_scene->stage->ScheduleCoroutine(bullets.id[index], &bullet.coro_wake, 0);
+		}
+
+		PlaySound(SND_LAZER);
+		return bullets.id[index];
+	}
+
+	static instance_id SpawnSLazer(Game* ctx, float x, float y, float dir, float prep_time, float time, float thickness, int color, int coroutine) {
+		BulletArray& bullets = ctx->game_scene->stage->bullets;
+		Bullet* created = ctx->game_scene->stage->CreateBullet();
+		if (!created) {
+			ctx->game_scene->stage->FreeCoroutine(coroutine);
+			return SlotMap::NoneId(TYPE_BULLET);
+		}
+		Bullet& bullet = *created;
+		size_t index = bullets.IndexOf(&bullet);
+		bullets.x[index] = x;
+		bullets.y[index] = y;
+		bullets.SetDir(index, cpml::angle_wrap(dir));
+
+		bullets.type[index] = ProjectileType::SLazer;
+		bullet.target_length = 1'000.0f;
+		bullet.thickness = thickness;
+		bullet.lazer_time = prep_time;
+		bullet.lazer_lifetime = prep_time + time;
+		bullets.UpdateLazerShape(index);
+		bullets.UpdateMove(index);
+
+		bullet.sc.sprite = ctx->assets.GetSprite(SPR_LAZER);
+		bullet.sc.frame_index = (float)color;
+		bullet.coroutine = coroutine;
+		if (coroutine != LUA_REFNIL) {
+			ctx->game_scene->stage->ScheduleCoroutine(bullets.id[index], &bullet.coro_wake, 0);
+		}
+
+		return bullets.id[index];
+	}
+
+	static const char* const CREATE_ENEMY_KEYS[] = {"x", "y", "spd", "dir", "acc", "spr", "drops", "Script", "OnDeath", "OnUpdate", nullptr};
+
 	static int lua_CreateEnemy(lua_State* L) {
 		int argc = lua_getargc(L);
 
 		int i = 1;
-		float x   = lua_named_argf(L, argc, i++, "x", (float)PLAY_AREA_W / 2.0f);
-		float y   = lua_named_argf(L, argc, i++, "y", 0.0f);
-		float spd = lua_named_argf(L, argc, i++, "spd");
-		float dir = lua_named_argf(L, argc, i++, "dir");
-		float acc = lua_named_argf(L, argc, i++, "acc");
-		void* spr = lua_named_argp(L, argc, i++, "spr");
-		int drops = lua_named_argi(L, argc, i++, "drops");
+		float x   = lua_named_argf(L, argc, i++, (float)PLAY_AREA_W / 2.0f);
+		float y   = lua_named_argf(L, argc, i++, 0.0f);
+		float spd = lua_named_argf(L, argc, i++);
+		float dir = lua_named_argf(L, argc, i++);
+		float acc = lua_named_argf(L, argc, i++);
+		void* spr = lua_named_argp(L, argc, i++);
+		int drops = lua_named_argi(L, argc, i++);
 
-		Game* ctx = lua_getcontext(L);
+		Game* ctx = lua_upcontext(L);
 
 		int coroutine = LUA_REFNIL;
-		if (lua_named_argfunc(L, argc, i++, "Script")) {
-			coroutine = CreateCoroutine(L, ctx->game_scene->stage->L); // @main_thread
+		if (lua_named_argfunc(L, argc, i++)) {
+			coroutine = ctx->game_scene->stage->CreateCoroutine(L); // @main_thread
 		}
 
 		int death_callback = LUA_REFNIL;
-		if (lua_named_argfunc(L, argc, i++, "OnDeath")) {
+		if (lua_named_argfunc(L, argc, i++)) {
 			death_callback = luaL_ref(L, LUA_REGISTRYINDEX);
 		}
 
 		int update_callback = LUA_REFNIL;
-		if (lua_named_argfunc(L, argc, i++, "OnUpdate")) {
+		if (lua_named_argfunc(L, argc, i++)) {
 			update_callback = luaL_ref(L, LUA_REGISTRYINDEX);
 		}
 
-		Enemy& enemy = ctx->game_scene->stage->CreateEnemy();
-		enemy.x = x;
-		enemy.y = y;
-		enemy.spd = spd;
-		enemy.dir = cpml::angle_wrap(dir);
-		enemy.acc = acc;
-		enemy.radius = 10.0f;
-		enemy.sc.sprite = (SpriteData*)spr;
-		enemy.hp = 10.0f;
-		enemy.drops = drops;
-		enemy.coroutine = coroutine;
-		enemy.death_callback = death_callback;
-		enemy.update_callback = update_callback;
-		lua_pushinteger(L, enemy.id);
+		lua_pushinteger(L, SpawnEnemy(ctx, x, y, spd, dir, acc, spr, drops, coroutine, death_callback, update_callback));
 		return 1;
 	}
 
+	// CreateEnemyFast(x, y, spd, dir, acc, spr, drops, Script, OnDeath, OnUpdate)
+	static int lua_CreateEnemyFast(lua_State* L) {
+		lua_checkargc(L, 0, 10);
+
+		float x   = (float)luaL_optnumber(L, 1, (float)PLAY_AREA_W / 2.0f);
+		float y   = (float)luaL_optnumber(L, 2, 0.0);
+		float spd = (float)luaL_optnumber(L, 3, 0.0);
+		float dir = (float)luaL_optnumber(L, 4, 0.0);
+		float acc = (float)luaL_optnumber(L, 5, 0.0);
+		void* spr = nullptr;
+		if (!lua_isnoneornil(L, 6)) {
+			luaL_checktype(L, 6, LUA_TLIGHTUSERDATA);
+			spr = lua_touserdata(L, 6);
+		}
+		int drops = (int)luaL_optinteger(L, 7, 0);
+
+		Game* ctx = lua_upcontext(L);
+
+		int coroutine = LUA_REFNIL;
+		if (lua_argfunc(L, 8)) {
+			coroutine = ctx->game_scene->stage->CreateCoroutine(L); // @main_thread
+		}
+
+		int death_callback = LUA_REFNIL;
+		if (lua_argfunc(L, 9)) {
+			death_callback = luaL_ref(L, LUA_REGISTRYINDEX);
+		}
+
+		int update_callback = LUA_REFNIL;
+		if (lua_argfunc(L, 10)) {
+			update_callback = luaL_ref(L, LUA_REGISTRYINDEX);
+		}
+
+		lua_pushinteger(L, SpawnEnemy(ctx, x, y, spd, dir, acc, spr, drops, coroutine, death_callback, update_callback));
+		return 1;
+	}
+
+	static const char* const CREATE_BOSS_KEYS[] = {"x", "y", "spd", "dir", "acc", "type", nullptr};
+
 	static int lua_CreateBoss(lua_State* L) {
 		int argc = lua_getargc(L);
 
 		int i = 1;
-		float x   = lua_named_argf(L, argc, i++, "x", BOSS_STARTING_X);
-		float y   = lua_named_argf(L, argc, i++, "y", BOSS_STARTING_Y);
-		float spd = lua_named_argf(L, argc, i++, "spd");
-		float dir = lua_named_argf(L, argc, i++, "dir");
-		float acc = lua_named_argf(L, argc, i++, "acc");
-		int type  = lua_named_argi(L, argc, i++, "type");
+		float x   = lua_named_argf(L, argc, i++, BOSS_STARTING_X);
+		float y   = lua_named_argf(L, argc, i++, BOSS_STARTING_Y);
+		float spd = lua_named_argf(L, argc, i++);
+		float dir = lua_named_argf(L, argc, i++);
+		float acc = lua_named_argf(L, argc, i++);
+		int type  = lua_named_argi(L, argc, i++);
 
-		Game* ctx = lua_getcontext(L);
+		Game* ctx = lua_upcontext(L);
 
 		BossData* data = GetBossData(type);
 
@@ -227,7 +407,7 @@ namespace th {
 		boss.x = x;
 		boss.y = y;
 		boss.spd = spd;
-		boss.dir = cpml::angle_wrap(dir);
+		SetDir(boss, cpml::angle_wrap(dir));
 		boss.acc = acc;
 		boss.radius = 25.0f;
 		boss.sc.sprite = data->sprite;
@@ -239,128 +419,318 @@ namespace th {
 		return 1;
 	}
 
+	static const char* const SHOOT_KEYS[] = {"x", "y", "spd", "dir", "acc", "type", "color", "Script", nullptr};
+
 	static int lua_Shoot(lua_State* L) {
 		int argc = lua_getargc(L);
 
 		int i = 1;
-		float x   = lua_named_argf(L, argc, i++, "x");
-		float y   = lua_named_argf(L, argc, i++, "y");
-		float spd = lua_named_argf(L, argc, i++, "spd");
-		float dir = lua_named_argf(L, argc, i++, "dir");
-		float acc = lua_named_argf(L, argc, i++, "acc");
-		int type  = lua_named_argi(L, argc, i++, "type");
-		int color = lua_named_argi(L, argc, i++, "color");
+		float x   = lua_named_argf(L, argc, i++);
+		float y   = lua_named_argf(L, argc, i++);
+		float spd = lua_named_argf(L, argc, i++);
+		float dir = lua_named_argf(L, argc, i++);
+		float acc = lua_named_argf(L, argc, i++);
+		int type  = lua_named_argi(L, argc, i++);
+		int color = lua_named_argi(L, argc, i++);
 
-		Game* ctx = lua_getcontext(L);
+		Game* ctx = lua_upcontext(L);
 
 		int coroutine = LUA_REFNIL;
-		if (lua_named_argfunc(L, argc, i++, "Script")) {
-			coroutine = CreateCoroutine(L, ctx->game_scene->stage->L); // @main_thread
+		if (lua_named_argfunc(L, argc, i++)) {
+			coroutine = ctx->game_scene->stage->CreateCoroutine(L); // @main_thread
 		}
 
-		BulletData* data = GetBulletData(type);
+		lua_pushinteger(L, SpawnBullet(ctx, x, y, spd, dir, acc, type, color, coroutine));
+		return 1;
+	}
 
-		Bullet& bullet = ctx->game_scene->stage->CreateBullet();
-		bullet.x = x;
-		bullet.y = y;
-		bullet.spd = spd;
-		bullet.dir = cpml::angle_wrap(dir);
-		bullet.acc = acc;
+	// ShootFast(x, y, spd, dir, acc, type, color, Script)
+	static int lua_ShootFast(lua_State* L) {
+		lua_checkargc(L, 0, 8);
 
-		bullet.type = ProjectileType::Bullet;
-		bullet.radius = data->radius;
-		bullet.rotate = data->rotate;
+		float x   = (float)luaL_optnumber(L, 1, 0.0);
+		float y   = (float)luaL_optnumber(L, 2, 0.0);
+		float spd = (float)luaL_optnumber(L, 3, 0.0);
+		float dir = (float)luaL_optnumber(L, 4, 0.0);
+		float acc = (float)luaL_optnumber(L, 5, 0.0);
+		int type  = (int)luaL_optinteger(L, 6, 0);
+		int color = (int)luaL_optinteger(L, 7, 0);
 
-		bullet.sc.sprite = data->sprite;
-		bullet.sc.frame_index = (float)color;
-		bullet.coroutine = coroutine;
+		Game* ctx = lua_upcontext(L);
 
-		PlaySound("se_enemy_shoot.wav");
-		lua_pushinteger(L, bullet.id);
+		int coroutine = LUA_REFNIL;
+		if (lua_argfunc(L, 8)) {
+			coroutine = ctx->game_scene->stage->CreateCoroutine(L); // @main_thread
+		}
+
+		lua_pushinteger(L, SpawnBullet(ctx, x, y, spd, dir, acc, type, color, coroutine));
 		return 1;
 	}
 
+	// Yields for t ticks. The coroutine is parked in the stage's timer wheel
+	// instead of being resumed every tick just to count down.
+	static int lua_wait(lua_State* L) {
+		lua_Number t = luaL_checknumber(L, 1);
+		if (!(t > 0.0)) {
+			return 0;
+		}
+
+		if (!lua_isyieldable(L)) {
+			return luaL_error(L, "wait: not in a coroutine");
+		}
+
+		Game* ctx = lua_upcontext(L);
+		ctx->game_scene->stage->coro_sleep = (unsigned int)std::ceil(std::min(t, (lua_Number)(1 << 30)));
+		return lua_yield(L, 0);
+	}
+
+	static const char* const SHOOT_LAZER_KEYS[] = {"x", "y", "spd", "dir", "length", "thickness", "color", "Script", nullptr};
+
 	static int lua_ShootLazer(lua_State* L) {
 		int argc = lua_getargc(L);
 
 		int i = 1;
-		float x   = lua_named_argf(L, argc, i++, "x");
-		float y   = lua_named_argf(L, argc, i++, "y");
-		float spd = lua_named_argf(L, argc, i++, "spd");
-		float dir = lua_named_argf(L, argc, i++, "dir");
-		float length = lua_named_argf(L, argc, i++, "length");
-		float thickness = lua_named_argf(L, argc, i++, "thickness");
-		int color = lua_named_argi(L, argc, i++, "color");
+		float x   = lua_named_argf(L, argc, i++);
+		float y   = lua_named_argf(L, argc, i++);
+		float spd = lua_named_argf(L, argc, i++);
+		float dir = lua_named_argf(L, argc, i++);
+		float length = lua_named_argf(L, argc, i++);
+		float thickness = lua_named_argf(L, argc, i++);
+		int color = lua_named_argi(L, argc, i++);
 
-		Game* ctx = lua_getcontext(L);
+		Game* ctx = lua_upcontext(L);
 
 		int coroutine = LUA_REFNIL;
-		if (lua_named_argfunc(L, argc, i++, "Script")) {
-			coroutine = CreateCoroutine(L, ctx->game_scene->stage->L); // @main_thread
+		if (lua_named_argfunc(L, argc, i++)) {
+			coroutine = ctx->game_scene->stage->CreateCoroutine(L); // @main_thread
 		}
 
-		if (spd == 0.0f) spd = 1.0f;
-		if (length == 0.0f) length = 1.0f;
-		float time = length / spd;
+		lua_pushinteger(L, SpawnLazer(ctx, x, y, spd, dir, length, thickness, color, coroutine));
+		return 1;
+	}
 
-		Bullet& bullet = ctx->game_scene->stage->CreateBullet();
-		bullet.x = x;
-		bullet.y = y;
-		bullet.spd = spd;
-		bullet.dir = cpml::angle_wrap(dir);
+	// ShootLazerFast(x, y, spd, dir, length, thickness, color, Script)
+	static int lua_ShootLazerFast(lua_State* L) {
+		lua_checkargc(L, 0, 8);
 
-		bullet.type = ProjectileType::Lazer;
-		bullet.target_length = length;
-		bullet.thickness = thickness;
-		bullet.lazer_time = time;
+		float x   = (float)luaL_optnumber(L, 1, 0.0);
+		float y   = (float)luaL_optnumber(L, 2, 0.0);
+		float spd = (float)luaL_optnumber(L, 3, 0.0);
+		float dir = (float)luaL_optnumber(L, 4, 0.0);
+		float length = (float)luaL_optnumber(L, 5, 0.0);
+		float thickness = (float)luaL_optnumber(L, 6, 0.0);
+		int color = (int)luaL_optinteger(L, 7, 0);
 
-		bullet.sc.sprite = ctx->assets.GetSprite("Lazer");
-		bullet.sc.frame_index = (float)color;
-		bullet.coroutine = coroutine;
+		Game* ctx = lua_upcontext(L);
 
-		PlaySound("se_lazer.wav");
-		lua_pushinteger(L, bullet.id);
+		int coroutine = LUA_REFNIL;
+		if (lua_argfunc(L, 8)) {
+			coroutine = ctx->game_scene->stage->CreateCoroutine(L); // @main_thread
+		}
+
+		lua_pushinteger(L, SpawnLazer(ctx, x, y, spd, dir, length, thickness, color, coroutine));
 		return 1;
 	}
 
+	static const char* const SHOOT_SLAZER_KEYS[] = {"x", "y", "dir", "wait_time", "lifespan", "thickness", "color", "Script", nullptr};
+
 	static int lua_ShootSLazer(lua_State* L) {
 		int argc = lua_getargc(L);
 
 		int i = 1;
-		float x   = lua_named_argf(L, argc, i++, "x");
-		float y   = lua_named_argf(L, argc, i++, "y");
-		float dir = lua_named_argf(L, argc, i++, "dir");
-		float prep_time = lua_named_argf(L, argc, i++, "wait_time");
-		float time = lua_named_argf(L, argc, i++, "lifespan");
-		float thickness = lua_named_argf(L, argc, i++, "thickness");
-		int color = lua_named_argi(L, argc, i++, "color");
+		float x   = lua_named_argf(L, argc, i++);
+		float y   = lua_named_argf(L, argc, i++);
+		float dir = lua_named_argf(L, argc, i++);
+		float prep_time = lua_named_argf(L, argc, i++);
+		float time = lua_named_argf(L, argc, i++);
+		float thickness = lua_named_argf(L, argc, i++);
+		int color = lua_named_argi(L, argc, i++);
 
-		Game* ctx = lua_getcontext(L);
+		Game* ctx = lua_upcontext(L);
 
 		int coroutine = LUA_REFNIL;
-		if (lua_named_argfunc(L, argc, i++, "Script")) {
-			coroutine = CreateCoroutine(L, ctx->game_scene->stage->L); // @main_thread
+		if (lua_named_argfunc(L, argc, i++)) {
+			coroutine = ctx->game_scene->stage->CreateCoroutine(L); // @main_thread
 		}
 
-		Bullet& bullet = ctx->game_scene->stage->CreateBullet();
-		bullet.x = x;
-		bullet.y = y;
-		bullet.dir = cpml::angle_wrap(dir);
+		lua_pushinteger(L, SpawnSLazer(ctx, x, y, dir, prep_time, time, thickness, color, coroutine));
+		return 1;
+	}
 
-		bullet.type = ProjectileType::SLazer;
-		bullet.target_length = 1'000.0f;
-		bullet.thickness = thickness;
-		bullet.lazer_time = prep_time;
-		bullet.lazer_lifetime = prep_time + time;
+	// ShootSLazerFast(x, y, dir, wait_time, lifespan, thickness, color, Script)
+	static int lua_ShootSLazerFast(lua_State* L) {
+		lua_checkargc(L, 0, 8);
 
-		bullet.sc.sprite = ctx->assets.GetSprite("Lazer");
-		bullet.sc.frame_index = (float)color;
-		bullet.coroutine = coroutine;
+		float x   = (float)luaL_optnumber(L, 1, 0.0);
+		float y   = (float)luaL_optnumber(L, 2, 0.0);
+		float dir = (float)luaL_optnumber(L, 3, 0.0);
+		float prep_time = (float)luaL_optnumber(L, 4, 0.0);
+		float time = (float)luaL_optnumber(L, 5, 0.0);
+		float thickness = (float)luaL_optnumber(L, 6, 0.0);
+		int color = (int)luaL_optinteger(L, 7, 0);
+
+		Game* ctx = lua_upcontext(L);
+
+		int coroutine = LUA_REFNIL;
+		if (lua_argfunc(L, 8)) {
+			coroutine = ctx->game_scene->stage->CreateCoroutine(L); // @main_thread
+		}
+
+		lua_pushinteger(L, SpawnSLazer(ctx, x, y, dir, prep_time, time, thickness, color, coroutine));
+		return 1;
+	}
+
+	// Shoots n bullets in one call: bullet i gets dir + dir_step * (i - (n - 1) / 2)
+	// and spd + spd_step * i. The arguments before n are ShootFast's.
+	static int ShootBulk(lua_State* L, int n, float dir_step, float spd_step, int script_arg) {
+		float x   = (float)luaL_optnumber(L, 1, 0.0);
+		float y   = (float)luaL_optnumber(L, 2, 0.0);
+		float spd = (float)luaL_optnumber(L, 3, 0.0);
+		float dir = (float)luaL_optnumber(L, 4, 0.0);
+		float acc = (float)luaL_optnumber(L, 5, 0.0);
+		int type  = (int)luaL_optinteger(L, 6, 0);
+		int color = (int)luaL_optinteger(L, 7, 0);
+
+		bool script = !lua_isnoneornil(L, script_arg);
+		if (script) {
+			luaL_checktype(L, script_arg, LUA_TFUNCTION);
+		}
+
+		Game* ctx = lua_upcontext(L);
+		Stage& stage = *ctx->game_scene->stage;
+		n = std::max(n, 0);
+		stage.bullets.Reserve((size_t)n);
+
+		lua_createtable(L, n, 0);
+		for (int i = 0; i < n; i++) {
+			int coroutine = LUA_REFNIL;
+			if (script) {
+				lua_pushvalue(L, script_arg);
+				coroutine = stage.CreateCoroutine(L); // @main_thread
+			}
+
+			float mul = (float)i - (float)(n - 1) / 2.0f;
+			lua_pushinteger(L, SpawnBullet(ctx, x, y, spd + spd_step * (float)i, dir + dir_step * mul, acc, type, color, coroutine, false));
+			lua_rawseti(L, -2, i + 1);
+		}
+
+		if (n > 0) {
+			PlaySound(SND_ENEMY_SHOOT);
+		}
+		return 1;
+	}
+
+	// ShootArc(x, y, spd, dir, acc, type, color, n, dir_step, spd_step, Script)
+	static int lua_ShootArc(lua_State* L) {
+		lua_checkargc(L, 8, 11);
+		int n = (int)luaL_checkinteger(L, 8);
+		float dir_step = (float)luaL_optnumber(L, 9, 0.0);
+		float spd_step = (float)luaL_optnumber(L, 10, 0.0);
+		return ShootBulk(L, n, dir_step, spd_step, 11);
+	}
+
+	// ShootStack(x, y, spd, dir, acc, type, color, n, spd_step, Script)
+	static int lua_ShootStack(lua_State* L) {
+		lua_checkargc(L, 8, 10);
+		int n = (int)luaL_checkinteger(L, 8);
+		float spd_step = (float)luaL_optnumber(L, 9, 0.0);
+		return ShootBulk(L, n, 0.0f, spd_step, 10);
+	}
+
+	static void RotateObject(Game* ctx, instance_id id, float delta) {
+		Stage& stage = *ctx->game_scene->stage;
+		switch (id >> TYPE_PART_SHIFT) {
+			case TYPE_BULLET: {
+				if (Bullet* bullet = stage.FindBullet(id)) {
+					size_t index = stage.bullets.IndexOf(bullet);
+					stage.bullets.SetDir(index, cpml::angle_wrap(stage.bullets.dir[index] + delta));
+				}
+				break;
+			}
+			case TYPE_ENEMY: {
+				if (Enemy* enemy = stage.FindEnemy(id)) {
+					SetDir(*enemy, cpml::angle_wrap(enemy->dir + delta));
+				}
+				break;
+			}
+			case TYPE_BOSS: {
+				if (Boss* boss = stage.FindBoss(id)) {
+					SetDir(*boss, cpml::angle_wrap(boss->dir + delta));
+				}
+				break;
+			}
+		}
+	}
+
+	// rotates what the i-th call of ShootRadial's function returned (an id or
+	// a table of ids) and appends it to the result table at 4, pops it
+	static void ShootRadialFan(lua_State* L, Game* ctx, int i) {
+		int n = (int)lua_tointeger(L, 1);
+		float dir_diff = (float)lua_tonumber(L, 2);
+		float delta = dir_diff * ((float)i - (float)(n - 1) / 2.0f);
+
+		if (lua_istable(L, -1)) {
+			for (lua_Integer j = 1, len = (lua_Integer)lua_rawlen(L, -1); j <= len; j++) {
+				lua_rawgeti(L, -1, j);
+				RotateObject(ctx, (instance_id)lua_tointeger(L, -1), delta);
+				lua_rawseti(L, 4, (lua_Integer)lua_rawlen(L, 4) + 1);
+			}
+		} else if (lua_type(L, -1) == LUA_TNUMBER) {
+			RotateObject(ctx, (instance_id)lua_tointeger(L, -1), delta);
+			lua_pushvalue(L, -1);
+			lua_rawseti(L, 4, (lua_Integer)lua_rawlen(L, 4) + 1);
+		}
+		lua_pop(L, 1);
+	}
+
+	// the function can wait, then the loop continues here on resume
+	static int lua_ShootRadialK(lua_State* L, int status, lua_KContext k) {
+		Game* ctx = lua_upcontext(L);
+		int n = (int)lua_tointeger(L, 1);
+		int i = (int)k;
+
+		if (status == LUA_YIELD) {
+			ShootRadialFan(L, ctx, i);
+			i++;
+		}
 
-		lua_pushinteger(L, bullet.id);
+		for (; i < n; i++) {
+			lua_pushvalue(L, 3);
+			lua_pushinteger(L, i);
+			lua_callk(L, 1, 1, (lua_KContext)i, lua_ShootRadialK);
+			ShootRadialFan(L, ctx, i);
+		}
+
+		lua_settop(L, 4);
 		return 1;
 	}
 
+	// ShootRadial(n, dir_diff, f): calls f(i) n times and fans what it
+	// returns out around its direction, dir_diff apart. Returns the ids.
+	static int lua_ShootRadial(lua_State* L) {
+		lua_checkargc(L, 3, 3);
+		int n = (int)luaL_checkinteger(L, 1);
+		luaL_checknumber(L, 2);
+		luaL_checktype(L, 3, LUA_TFUNCTION);
+
+		Game* ctx = lua_upcontext(L);
+		ctx->game_scene->stage->bullets.Reserve((size_t)std::max(n, 0));
+
+		lua_createtable(L, std::max(n, 0), 0);
+		return lua_ShootRadialK(L, LUA_OK, 0);
+	}
+
+	// registers f as a closure over the Game and the interned keys
+	static void lua_register_closure(lua_State* L, Game* ctx, const char* name, lua_CFunction f, const char* const* keys = nullptr) {
+		int n = 1;
+		lua_pushlightuserdata(L, ctx);
+		for (; keys && *keys; keys++, n++) {
+			lua_pushstring(L, *keys);
+		}
+		lua_pushcclosure(L, f, n);
+		lua_setglobal(L, name);
+	}
+
 	static int lua_FindSprite(lua_State* L) {
 		lua_checkargc(L, 1, 1);
 		//size_t size;
@@ -376,7 +746,7 @@ namespace th {
 	template <
 		typename T,
 		void (*PushFunc)(lua_State* L, T value),
-		T (*GetFromBullet)(Bullet* bullet),
+		T (*GetFromBullet)(BulletArray& bullets, size_t index),
 		T (*GetFromEnemy)(Enemy* enemy),
 		T (*GetFromPlayer)(Player* player),
 		T (*GetFromBoss)(Boss* boss),
@@ -391,7 +761,8 @@ namespace th {
 		switch (type) {
 			case TYPE_BULLET: {
 				if (Bullet* bullet = ctx->game_scene->stage->FindBullet(id)) {
-					if (GetFromBullet != nullptr) value = GetFromBullet(bullet);
+					BulletArray& bullets = ctx->game_scene->stage->bullets;
+					if (GetFromBullet != nullptr) value = GetFromBullet(bullets, bullets.IndexOf(bullet));
 				}
 				break;
 			}
@@ -425,7 +796,7 @@ namespace th {
 	template <
 		typename T,
 		T (*ToFunc)(lua_State* L, int idx),
-		void (*BulletSet)(Bullet* bullet, T value),
+		void (*BulletSet)(BulletArray& bullets, size_t index, T value),
 		void (*EnemySet)(Enemy* enemy, T value),
 		void (*PlayerSet)(Player* player, T value),
 		void (*BossSet)(Boss* boss, T value)
@@ -439,7 +810,8 @@ namespace th {
 		switch (type) {
 			case TYPE_BULLET: {
 				if (Bullet* bullet = ctx->game_scene->stage->FindBullet(id)) {
-					if (BulletSet != nullptr) BulletSet(bullet, value);
+					BulletArray& bullets = ctx->game_scene->stage->bullets;
+					if (BulletSet != nullptr) BulletSet(bullets, bullets.IndexOf(bullet), value);
 				}
 				break;
 			}
@@ -570,6 +942,23 @@ namespace th {
 	static float GetAngleFromObject(Object* object) { return object->angle; }
 
 
+	// bullets: a column of BulletArray, or a field of the cold Bullet part
+	template <std::vector<float> BulletArray::*Column>
+	static float GetColumnFromBullet(BulletArray& bullets, size_t index) { return (bullets.*Column)[index]; }
+
+	template <typename T, T (*GetFromObject)(Bullet*)>
+	static T GetFromBulletData(BulletArray& bullets, size_t index) { return GetFromObject(&bullets.data[index]); }
+
+	static instance_id GetTargetFromBullet(BulletArray& bullets, size_t index) { return 0 | (TYPE_PLAYER << TYPE_PART_SHIFT); }
+
+	template <std::vector<float> BulletArray::*Column>
+	static void SetColumnForBullet(BulletArray& bullets, size_t index, float value) { (bullets.*Column)[index] = value; }
+	static void SetDirForBullet(BulletArray& bullets, size_t index, float value) { bullets.SetDir(index, cpml::angle_wrap(value)); }
+
+	template <typename T, void (*SetForObject)(Bullet*, T)>
+	static void SetForBulletData(BulletArray& bullets, size_t index, T value) { SetForObject(&bullets.data[index], value); }
+
+
 	template <typename Object>
 	static void SetXForObject(Object* object, float value) { object->x = value; }
 
@@ -580,7 +969,7 @@ namespace th {
 	static void SetSpdForObject(Object* object, float value) { object->spd = value; }
 
 	template <typename Object>
-	static void SetDirForObject(Object* object, float value) { object->dir = cpml::angle_wrap(value); }
+	static void SetDirForObject(Object* object, float value) { SetDir(*object, cpml::angle_wrap(value)); }
 
 	template <typename Object>
 	static void SetAccForObject(Object* object, float value) { object->acc = value; }
@@ -592,42 +981,50 @@ namespace th {
 	template <typename Object>
 	static void SetAngleForObject(Object* object, float value) { object->angle = value; }
 
-#if 0
-	static void *l_alloc (void *ud, void *ptr, size_t osize, size_t nsize) {
-		if (nsize == 0) {
-			//printf("lua free %d bytes\n", (int)osize);
-			printf("FREE ");
-			free(ptr);
-			return NULL;
-		} else if (ptr == nullptr) {
-			const char* s = "something else";
-			switch (osize) {
-				case LUA_TSTRING:   s = "string";   break;
-				case LUA_TTABLE:    s = "table";    break;
-				case LUA_TFUNCTION: s = "function"; break;
-				case LUA_TUSERDATA: s = "userdata"; break;
-				case LUA_TTHREAD:   s = "thread";   break;
-			}
-			//printf("lua alloc %d bytes (%s)\n", (int)nsize, s);
-			printf("ALLOC ");
-			return malloc(nsize);
-		} else {
-			//printf("lua realloc from %d bytes to %d bytes\n", (int)osize, (int)nsize);
-			printf("REALLOC ");
-			return realloc(ptr, nsize);
+	static int lua_panic(lua_State* L) {
+		const char* msg = lua_tostring(L, -1);
+		TH_SHOW_ERROR("unprotected error in call to Lua API\n%s", msg ? msg : "error object is not a string");
+		return 0; // lua aborts
+	}
+
+	// Runs a loaded chunk with `env` (a stack index) as its _ENV, or the
+	// global table if 0.
+	static bool RunScriptChunk(lua_State* L, int env) {
+		if (env != 0) {
+			lua_pushvalue(L, env);
+			lua_setupvalue(L, -2, 1); // a main chunk's only upvalue is _ENV
 		}
+
+		if (lua_pcall(L, 0, 0, 0) != LUA_OK) {
+			TH_SHOW_ERROR("error while running script\n%s", lua_tostring(L, -1));
+			lua_pop(L, 1);
+			return false;
+		}
+		return true;
 	}
-#endif
 
-	void Stage::InitLua() {
-		if (!(L = luaL_newstate())) {
-			TH_SHOW_ERROR("luaL_newstate failed");
+	bool Game::InitLua() {
+		TH_PROFILE_SCOPE("Game::InitLua");
+
+		Uint64 start_t = SDL_GetPerformanceCounter();
+		int script_count = 0;
+		int cached_count = 0;
+
+		lua_State* L = lua_newstate(LuaAllocator::Alloc, &lua_allocator);
+		if (!L) {
+			TH_SHOW_ERROR("lua_newstate failed");
+			return false;
 		}
+		lua = L;
+
+		lua_atpanic(L, lua_panic);
 
-		//lua_setallocf(L, l_alloc, nullptr);
+		// most script garbage is short lived (argument tables, closures
+		// passed to ShootRadial), which is what young collections are for
+		lua_gc(L, LUA_GCGEN, 0, 0);
 
 		{
-			lua_pushlightuserdata(L, &game);
+			lua_pushlightuserdata(L, this);
 			lua_rawsetp(L, LUA_REGISTRYINDEX, nullptr);
 		}
 
@@ -651,24 +1048,34 @@ namespace th {
 		}
 
 		{
-			lua_register(L, "random", lua_random);
-			lua_register(L, "CreateEnemy", lua_CreateEnemy);
-			lua_register(L, "CreateBoss", lua_CreateBoss);
-			lua_register(L, "Shoot", lua_Shoot);
-			lua_register(L, "ShootLazer", lua_ShootLazer);
-			lua_register(L, "ShootSLazer", lua_ShootSLazer);
+			lua_register_closure(L, this, "random", lua_random);
+			lua_register_closure(L, this, "wait", lua_wait);
+			lua_register_closure(L, this, "CreateEnemy", lua_CreateEnemy, CREATE_ENEMY_KEYS);
+			lua_register_closure(L, this, "CreateBoss", lua_CreateBoss, CREATE_BOSS_KEYS);
+			lua_register_closure(L, this, "Shoot", lua_Shoot, SHOOT_KEYS);
+			lua_register_closure(L, this, "ShootLazer", lua_ShootLazer, SHOOT_LAZER_KEYS);
+			lua_register_closure(L, this, "ShootSLazer", lua_ShootSLazer, SHOOT_SLAZER_KEYS);
+
+			// same without the argument table, for spawning in loops
+			lua_register_closure(L, this, "CreateEnemyFast", lua_CreateEnemyFast);
+			lua_register_closure(L, this, "ShootFast", lua_ShootFast);
+			lua_register_closure(L, this, "ShootLazerFast", lua_ShootLazerFast);
+			lua_register_closure(L, this, "ShootSLazerFast", lua_ShootSLazerFast);
+			lua_register_closure(L, this, "ShootRadial", lua_ShootRadial);
+			lua_register_closure(L, this, "ShootArc", lua_ShootArc);
+			lua_register_closure(L, this, "ShootStack", lua_ShootStack);
 			lua_register(L, "Exists", lua_Exists);
 			lua_register(L, "FindSprite", lua_FindSprite);
 			lua_register(L, "Destroy", lua_Destroy);
 
-			lua_CFunction GetX = lua_GetObjectVar<float, ObjectVarPushFloat, GetXFromObject<Bullet>, GetXFromObject<Enemy>, GetXFromObject<Player>, GetXFromObject<Boss>>;
-			lua_CFunction GetY = lua_GetObjectVar<float, ObjectVarPushFloat, GetYFromObject<Bullet>, GetYFromObject<Enemy>, GetYFromObject<Player>, GetYFromObject<Boss>>;
-			lua_CFunction GetSpd = lua_GetObjectVar<float, ObjectVarPushFloat, GetSpdFromObject<Bullet>, GetSpdFromObject<Enemy>, GetSpdFromPlayer, GetSpdFromObject<Boss>>;
-			lua_CFunction GetDir = lua_GetObjectVar<float, ObjectVarPushFloat, GetDirFromObject<Bullet>, GetDirFromObject<Enemy>, GetDirFromPlayer, GetDirFromObject<Boss>>;
-			lua_CFunction GetAcc = lua_GetObjectVar<float, ObjectVarPushFloat, GetAccFromObject<Bullet>, GetAccFromObject<Enemy>, nullptr, GetAccFromObject<Boss>>;
-			lua_CFunction GetTarget = lua_GetObjectVar<instance_id, ObjectVarPushID, GetTargetFromObject<Bullet>, GetTargetFromObject<Enemy>, nullptr, GetTargetFromObject<Boss>, GetTargetFromStage>;
-			lua_CFunction GetSpr = lua_GetObjectVar<void*, ObjectVarPushLUserdata, GetSprFromObject<Bullet>, GetSprFromObject<Enemy>, GetSprFromObject<Player>, GetSprFromObject<Boss>>;
-			lua_CFunction GetImg = lua_GetObjectVar<float, ObjectVarPushFloat, GetImgFromObject<Bullet>, GetImgFromObject<Enemy>, GetImgFromObject<Player>, GetImgFromObject<Boss>>;
+			lua_CFunction GetX = lua_GetObjectVar<float, ObjectVarPushFloat, GetColumnFromBullet<&BulletArray::x>, GetXFromObject<Enemy>, GetXFromObject<Player>, GetXFromObject<Boss>>;
+			lua_CFunction GetY = lua_GetObjectVar<float, ObjectVarPushFloat, GetColumnFromBullet<&BulletArray::y>, GetYFromObject<Enemy>, GetYFromObject<Player>, GetYFromObject<Boss>>;
+			lua_CFunction GetSpd = lua_GetObjectVar<float, ObjectVarPushFloat, GetColumnFromBullet<&BulletArray::spd>, GetSpdFromObject<Enemy>, GetSpdFromPlayer, GetSpdFromObject<Boss>>;
+			lua_CFunction GetDir = lua_GetObjectVar<float, ObjectVarPushFloat, GetColumnFromBullet<&BulletArray::dir>, GetDirFromObject<Enemy>, GetDirFromPlayer, GetDirFromObject<Boss>>;
+			lua_CFunction GetAcc = lua_GetObjectVar<float, ObjectVarPushFloat, GetColumnFromBullet<&BulletArray::acc>, GetAccFromObject<Enemy>, nullptr, GetAccFromObject<Boss>>;
+			lua_CFunction GetTarget = lua_GetObjectVar<instance_id, ObjectVarPushID, GetTargetFromBullet, GetTargetFromObject<Enemy>, nullptr, GetTargetFromObject<Boss>, GetTargetFromStage>;
+			lua_CFunction GetSpr = lua_GetObjectVar<void*, ObjectVarPushLUserdata, GetFromBulletData<void*, GetSprFromObject<Bullet>>, GetSprFromObject<Enemy>, GetSprFromObject<Player>, GetSprFromObject<Boss>>;
+			lua_CFunction GetImg = lua_GetObjectVar<float, ObjectVarPushFloat, GetFromBulletData<float, GetImgFromObject<Bullet>>, GetImgFromObject<Enemy>, GetImgFromObject<Player>, GetImgFromObject<Boss>>;
 			lua_CFunction GetAngle = lua_GetObjectVar<float, ObjectVarPushFloat, nullptr, GetAngleFromObject<Enemy>, nullptr, nullptr>;
 
 			lua_register(L, "GetX", GetX);
@@ -681,13 +1088,13 @@ namespace th {
 			lua_register(L, "GetImg", GetImg);
 			lua_register(L, "GetAngle", GetAngle);
 
-			lua_CFunction SetX = lua_SetObjectVar<float, ObjectVarToFloat, SetXForObject<Bullet>, SetXForObject<Enemy>, SetXForObject<Player>, SetXForObject<Boss>>;
-			lua_CFunction SetY = lua_SetObjectVar<float, ObjectVarToFloat, SetYForObject<Bullet>, SetYForObject<Enemy>, SetYForObject<Player>, SetYForObject<Boss>>;
-			lua_CFunction SetSpd = lua_SetObjectVar<float, ObjectVarToFloat, SetSpdForObject<Bullet>, SetSpdForObject<Enemy>, nullptr, SetSpdForObject<Boss>>;
-			lua_CFunction SetDir = lua_SetObjectVar<float, ObjectVarToFloat, SetDirForObject<Bullet>, SetDirForObject<Enemy>, nullptr, SetDirForObject<Boss>>;
-			lua_CFunction SetAcc = lua_SetObjectVar<float, ObjectVarToFloat, SetAccForObject<Bullet>, SetAccForObject<Enemy>, nullptr, SetAccForObject<Boss>>;
-			lua_CFunction SetSpr = lua_SetObjectVar<void*, ObjectVarToLUserdata, SetSprForObject<Bullet>, SetSprForObject<Enemy>, SetSprForObject<Player>, SetSprForObject<Boss>>;
-			lua_CFunction SetImg = lua_SetObjectVar<float, ObjectVarToFloat, SetImgForObject<Bullet>, SetImgForObject<Enemy>, SetImgForObject<Player>, SetImgForObject<Boss>>;
+			lua_CFunction SetX = lua_SetObjectVar<float, ObjectVarToFloat, SetColumnForBullet<&BulletArray::x>, SetXForObject<Enemy>, SetXForObject<Player>, SetXForObject<Boss>>;
+			lua_CFunction SetY = lua_SetObjectVar<float, ObjectVarToFloat, SetColumnForBullet<&BulletArray::y>, SetYForObject<Enemy>, SetYForObject<Player>, SetYForObject<Boss>>;
+			lua_CFunction SetSpd = lua_SetObjectVar<float, ObjectVarToFloat, SetColumnForBullet<&BulletArray::spd>, SetSpdForObject<Enemy>, nullptr, SetSpdForObject<Boss>>;
+			lua_CFunction SetDir = lua_SetObjectVar<float, ObjectVarToFloat, SetDirForBullet, SetDirForObject<Enemy>, nullptr, SetDirForObject<Boss>>;
+			lua_CFunction SetAcc = lua_SetObjectVar<float, ObjectVarToFloat, SetColumnForBullet<&BulletArray::acc>, SetAccForObject<Enemy>, nullptr, SetAccForObject<Boss>>;
+			lua_CFunction SetSpr = lua_SetObjectVar<void*, ObjectVarToLUserdata, SetForBulletData<void*, SetSprForObject<Bullet>>, SetSprForObject<Enemy>, SetSprForObject<Player>, SetSprForObject<Boss>>;
+			lua_CFunction SetImg = lua_SetObjectVar<float, ObjectVarToFloat, SetForBulletData<float, SetImgForObject<Bullet>>, SetImgForObject<Enemy>, SetImgForObject<Player>, SetImgForObject<Boss>>;
 			lua_CFunction SetAngle = lua_SetObjectVar<float, ObjectVarToFloat, nullptr, SetAngleForObject<Enemy>, nullptr, nullptr>;
 
 			lua_register(L, "SetX", SetX);
@@ -698,11 +1105,61 @@ namespace th {
 			lua_register(L, "SetSpr", SetSpr);
 			lua_register(L, "SetImg", SetImg);
 			lua_register(L, "SetAngle", SetAngle);
+		}
+
+		// the shared scripts go into _G once, stages only read them
+		{
+			auto& scripts = assets.GetScripts();
+
+			for (auto it = scripts.begin(); it != scripts.end(); ++it) {
+				ScriptData* script = it->second;
+
+				if (script->stage_index != -1) {
+					continue;
+				}
+
+				bool cached;
+				if (assets.LoadScriptChunk(L, script, it->first.c_str(), &cached) != LUA_OK) {
+					TH_SHOW_ERROR("luaL_loadbuffer failed\n%s", lua_tostring(L, -1));
+					lua_settop(L, 0);
+					continue;
+				}
+				script_count++;
+				cached_count += cached;
+
+				RunScriptChunk(L, 0);
+			}
+		}
+
+		double took = (double)(SDL_GetPerformanceCounter() - start_t) / (double)SDL_GetPerformanceFrequency();
+		printf("lua vm init %.2fms, %d/%d scripts from bytecode cache\n", 1000.0 * took, cached_count, script_count);
+
+		return true;
+	}
+
+	void Stage::InitLua() {
+		TH_PROFILE_SCOPE("Stage::InitLua");
+
+		Uint64 start_t = SDL_GetPerformanceCounter();
+		int script_count = 0;
+		int cached_count = 0;
+
+		L = game.lua;
+
+		// globals set by this run's scripts land in the _ENV, everything
+		// else is looked up in _G
+		lua_newtable(L);
+		int env = lua_gettop(L);
+		{
+			lua_createtable(L, 0, 1);
+			lua_pushglobaltable(L);
+			lua_setfield(L, -2, "__index");
+			lua_setmetatable(L, env);
 
 			lua_pushboolean(L, game.skip_to_midboss);
-			lua_setglobal(L, "SKIP_TO_MIDBOSS");
+			lua_setfield(L, env, "SKIP_TO_MIDBOSS");
 			lua_pushboolean(L, game.skip_to_boss);
-			lua_setglobal(L, "SKIP_TO_BOSS");
+			lua_setfield(L, env, "SKIP_TO_BOSS");
 		}
 
 		{
@@ -711,34 +1168,43 @@ namespace th {
 			for (auto it = scripts.begin(); it != scripts.end(); ++it) {
 				ScriptData* script = it->second;
 
-				if (!(script->stage_index == game.stage_index || script->stage_index == -1)) {
+				if (script->stage_index != game.stage_index) {
 					continue;
 				}
 
-				const char* buffer = script->buffer.data();
-				size_t buffer_size = script->buffer.size();
-				const char* debug_name = it->first.c_str();
-
-				if (luaL_loadbuffer(L, buffer, buffer_size, debug_name) != LUA_OK) {
+				bool cached;
+				if (game.assets.LoadScriptChunk(L, script, it->first.c_str(), &cached) != LUA_OK) {
 					TH_SHOW_ERROR("luaL_loadbuffer failed\n%s", lua_tostring(L, -1));
-					lua_settop(L, 0);
+					lua_settop(L, env);
 					continue;
 				}
+				script_count++;
+				cached_count += cached;
 
-				if (lua_pcall(L, 0, 0, 0) != LUA_OK) {
-					TH_SHOW_ERROR("error while running script\n%s", lua_tostring(L, -1));
-					lua_settop(L, 0);
-					continue;
-				}
+				RunScriptChunk(L, env);
 			}
 		}
 
+		env_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
 		{
 			StageData* data = GetStageData(game.stage_index);
 
-			lua_getglobal(L, data->script);
-			coroutine = CreateCoroutine(L, L);
+			PushStageGlobal(data->script);
+			coroutine = CreateCoroutine(L);
+			if (coroutine != LUA_REFNIL) {
+				ScheduleCoroutine(STAGE_COROUTINE_ID, &coro_wake, 0);
+			}
 		}
+
+		double took = (double)(SDL_GetPerformanceCounter() - start_t) / (double)SDL_GetPerformanceFrequency();
+		printf("lua init %.2fms, %d/%d scripts from bytecode cache\n", 1000.0 * took, cached_count, script_count);
+	}
+
+	void Stage::PushStageGlobal(const char* name) {
+		lua_rawgeti(L, LUA_REGISTRYINDEX, env_ref);
+		lua_getfield(L, -1, name); // falls back to _G
+		lua_remove(L, -2);
 	}
 
 	bool CallLuaFunction(lua_State* L, int ref, instance_id id) {
@@ -764,27 +1230,20 @@ namespace th {
 		return true;
 	}
 
-	void UpdateCoroutine(lua_State* L, int* coroutine, instance_id id) {
-		if (*coroutine == LUA_REFNIL) {
-			return;
-		}
-
-		lua_rawgeti(L, LUA_REGISTRYINDEX, *coroutine);
+	// false once the coroutine has finished or failed, the caller unrefs it
+	bool UpdateCoroutine(lua_State* L, int coroutine, instance_id id) {
+		lua_rawgeti(L, LUA_REGISTRYINDEX, coroutine);
 		if (!lua_isthread(L, -1)) {
 			TH_SHOW_ERROR("UpdateCoroutine: not a thread");
 			lua_settop(L, 0);
-			luaL_unref(L, LUA_REGISTRYINDEX, *coroutine);
-			*coroutine = LUA_REFNIL;
-			return;
+			return false;
 		}
 
 		lua_State* NL = lua_tothread(L, -1);
 		lua_pop(L, 1);
 
 		if (!lua_isyieldable(NL)) {
-			luaL_unref(L, LUA_REGISTRYINDEX, *coroutine);
-			*coroutine = LUA_REFNIL;
-			return;
+			return false;
 		}
 
 		lua_pushinteger(NL, id);
@@ -792,14 +1251,15 @@ namespace th {
 		int res = lua_resume(NL, L, 1, &nres);
 		if (res == LUA_OK) {
 			lua_pop(NL, nres);
-			luaL_unref(L, LUA_REGISTRYINDEX, *coroutine);
-			*coroutine = LUA_REFNIL;
+			return false;
 		} else if (res != LUA_YIELD) {
 			TH_SHOW_ERROR("UpdateCoroutine:\n%s", lua_tostring(NL, -1));
 			lua_settop(NL, 0);
-			luaL_unref(L, LUA_REGISTRYINDEX, *coroutine);
-			*coroutine = LUA_REFNIL;
+			return false;
 		}
+
+		lua_pop(NL, nres);
+		return true;
 	}
 
 }
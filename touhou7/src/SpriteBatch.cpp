@@ -0,0 +1,173 @@
+#include "SpriteBatch.h"
+
+#include "common.h"
+#include "cpml.h"
+
+namespace th {
+
+	void SpriteBatch::Init(SDL_Renderer* _renderer) {
+		renderer = _renderer;
+		vertices.reserve(4 * 4096);
+		indices.reserve(6 * 4096);
+	}
+
+	void SpriteBatch::DrawSprite(SpriteData* sprite, int frame_index, float x, float y, float angle, float xscale, float yscale, SDL_Color color) {
+		if (!sprite) return;
+		if (!sprite->texture) return;
+
+		int w = sprite->width;
+		int h = sprite->height;
+		int frames_in_row = sprite->frames_in_row;
+
+		frame_index = std::clamp(frame_index, 0, sprite->frame_count);
+
+		int cell_x = frame_index % frames_in_row;
+		int cell_y = frame_index / frames_in_row;
+
+		SDL_Rect src;
+		src.x = sprite->u + cell_x * w;
+		src.y = sprite->v + cell_y * h;
+		src.w = w;
+		src.h = h;
+
+		DrawQuad(sprite->texture, src, x, y, (float)sprite->xorigin, (float)sprite->yorigin, angle, xscale, yscale, color);
+	}
+
+	void SpriteBatch::DrawTextBitmap(SpriteFont* font, const char* text, int x, int y) {
+		if (!font) return;
+		if (!font->texture) return;
+		if (!text) return;
+
+		int text_x = x;
+		int text_y = y;
+
+		for (const char* ch = text; *ch; ch++) {
+			if (*ch == '\n') {
+				text_x = x;
+				text_y += font->height;
+				continue;
+			}
+
+			if (*ch != ' ') {
+				int frame_index = *ch - font->first;
+				SDL_Rect src;
+				src.x = font->u + (frame_index % font->frames_in_row) * font->sep_x;
+				src.y = font->v + (frame_index / font->frames_in_row) * font->sep_y;
+				src.w = font->width;
+				src.h = font->height;
+				DrawQuad(font->texture, src, (float)text_x, (float)text_y, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, {255, 255, 255, 255});
+			}
+
+			text_x += font->width;
+		}
+	}
+
+	void SpriteBatch::DrawText(GlyphAtlas* atlas, const char* text, int x, int y, SDL_Color color) {
+		if (!atlas) return;
+		if (!text) return;
+
+		int text_x = x;
+		int text_y = y;
+
+		for (const char* ch = text; *ch; ch++) {
+			unsigned char c = (unsigned char)*ch;
+			if (c == '\n') {
+				text_x = x;
+				text_y += atlas->line_skip;
+				continue;
+			}
+
+			if (c < GlyphAtlas::FIRST || c > GlyphAtlas::LAST) continue;
+
+			const GlyphAtlas::Glyph& glyph = atlas->glyphs[c - GlyphAtlas::FIRST];
+			if (glyph.src.w > 0) {
+				DrawQuad(atlas->texture, glyph.src, (float)(text_x + glyph.xoffset), (float)text_y, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, color);
+			}
+
+			text_x += glyph.advance;
+		}
+	}
+
+	void SpriteBatch::DrawQuad(SDL_Texture* _texture, const SDL_Rect& src, float x, float y, float xorigin, float yorigin, float angle, float xscale, float yscale, SDL_Color color, SDL_BlendMode _blend) {
+		if (!_texture) return;
+
+		if (_texture != texture || _blend != blend) {
+			Flush();
+			texture = _texture;
+			blend = _blend;
+			int tw;
+			int th;
+			SDL_QueryTexture(texture, nullptr, nullptr, &tw, &th);
+			texture_w = (float)tw;
+			texture_h = (float)th;
+		}
+
+		// corners relative to the origin, like the dest rect of SDL_RenderCopyEx
+		float sx = fabsf(xscale);
+		float sy = fabsf(yscale);
+		float left = -xorigin * sx;
+		float top = -yorigin * sy;
+		float right = left + (float)src.w * sx;
+		float bottom = top + (float)src.h * sy;
+
+		float u1 = (float)src.x / texture_w;
+		float v1 = (float)src.y / texture_h;
+		float u2 = (float)(src.x + src.w) / texture_w;
+		float v2 = (float)(src.y + src.h) / texture_h;
+		if (xscale < 0.0f) std::swap(u1, u2);
+		if (yscale < 0.0f) std::swap(v1, v2);
+
+		float c = 1.0f;
+		float s = 0.0f;
+		if (angle != 0.0f) {
+			c = cpml::dcos(angle);
+			s = cpml::dsin(angle);
+		}
+
+		int base = (int)vertices.size();
+		auto vertex = [&](float px, float py, float u, float v) {
+			SDL_Vertex& vert = vertices.emplace_back();
+			vert.position.x = x + px * c + py * s;
+			vert.position.y = y - px * s + py * c;
+			vert.color = color;
+			vert.tex_coord.x = u;
+			vert.tex_coord.y = v;
+		};
+		vertex(left,  top,    u1, v1);
+		vertex(right, top,    u2, v1);
+		vertex(right, bottom, u2, v2);
+		vertex(left,  bottom, u1, v2);
+
+		indices.push_back(base + 0);
+		indices.push_back(base + 1);
+		indices.push_back(base + 2);
+		indices.push_back(base + 0);
+		indices.push_back(base + 2);
+		indices.push_back(base + 3);
+
+		quads++;
+	}
+
+	void SpriteBatch::Flush() {
+		if (vertices.empty()) return;
+
+		// vertex colors replace the texture modulation DrawSprite used to set
+		SDL_SetTextureColorMod(texture, 255, 255, 255);
+		SDL_SetTextureAlphaMod(texture, 255);
+		SDL_SetTextureBlendMode(texture, blend);
+		SDL_RenderGeometry(renderer, texture, vertices.data(), (int)vertices.size(), indices.data(), (int)indices.size());
+
+		vertices.clear();
+		indices.clear();
+		batches++;
+	}
+
+	void SpriteBatch::EndFrame() {
+		Flush();
+		last_batches = batches;
+		last_quads = quads;
+		batches = 0;
+		quads = 0;
+	}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Assets.h"
+
+#include <vector>
+
+namespace th {
+
+	// Collects textured quads on the cpu and submits them with one
+	// SDL_RenderGeometry call per run of the same texture and blend mode.
+	// Anything drawn with the renderer directly has to Flush() first, and
+	// so does a render target change.
+	class SpriteBatch {
+	public:
+		void Init(SDL_Renderer* renderer);
+
+		// same parameters as DrawSprite
+		void DrawSprite(SpriteData* sprite, int frame_index, float x, float y, float angle = 0.0f, float xscale = 1.0f, float yscale = 1.0f, SDL_Color color = {255, 255, 255, 255});
+
+		void DrawTextBitmap(SpriteFont* font, const char* text, int x, int y);
+
+		// '\n' starts a new line, like TTF_RenderText_Blended_Wrapped with no wrap length
+		void DrawText(GlyphAtlas* atlas, const char* text, int x, int y, SDL_Color color = {255, 255, 255, 255});
+
+		// `angle` is counterclockwise in degrees around (x, y), negative scale flips
+		void DrawQuad(SDL_Texture* texture, const SDL_Rect& src, float x, float y, float xorigin, float yorigin, float angle, float xscale, float yscale, SDL_Color color, SDL_BlendMode blend = SDL_BLENDMODE_BLEND);
+
+		void Flush();
+
+		// stats of the last finished frame
+		void EndFrame();
+		int GetBatches() const { return last_batches; }
+		int GetQuads() const { return last_quads; }
+
+	private:
+		SDL_Renderer* renderer = nullptr;
+
+		SDL_Texture* texture = nullptr;
+		SDL_BlendMode blend = SDL_BLENDMODE_BLEND;
+		float texture_w = 1.0f;
+		float texture_h = 1.0f;
+
+		std::vector<SDL_Vertex> vertices;
+		std::vector<int> indices;
+
+		int batches = 0;
+		int quads = 0;
+		int last_batches = 0;
+		int last_quads = 0;
+	};
+
+}
@@ -8,9 +8,9 @@
 
 namespace th {
 
-	int CreateCoroutine(lua_State* L, lua_State* main_L);
-
 	bool Stage::Init() {
+		random.seed(game.stage_seed);
+
 		CreatePlayer();
 
 		InitLua();
@@ -20,7 +20,8 @@ namespace th {
 
 			StageData* data = GetStageData(game.stage_index);
 
-			if (data->init) {
+			// stage backgrounds talk to the renderer directly
+			if (data->init && !game.headless) {
 				(*data->init)(&game, game.renderer, stage_memory);
 			}
 		}
@@ -28,13 +29,18 @@ namespace th {
 		return true;
 	}
 
+	static bool AllRefsUnique(std::vector<int> refs) {
+		std::sort(refs.begin(), refs.end());
+		return std::adjacent_find(refs.begin(), refs.end()) == refs.end();
+	}
+
 	void Stage::Quit() {
 		game.skip_to_midboss = false;
 		game.skip_to_boss = false;
 
 		{
 			StageData* data = GetStageData(game.stage_index);
-			if (data->quit) {
+			if (data->quit && !game.headless) {
 				(*data->quit)(&game, stage_memory);
 			}
 		}
@@ -45,19 +51,40 @@ namespace th {
 			FreeEnemy(enemy);
 		}
 		enemies.clear();
+		enemy_slots.Clear();
 
-		for (Bullet& bullet : bullets) {
+		for (Bullet& bullet : bullets.data) {
 			FreeBullet(bullet);
 		}
-		bullets.clear();
+		bullets.Clear();
+		bullet_slots.Clear();
+
+		if (boss_exists) {
+			FreeBoss();
+			boss_exists = false;
+		}
 
-		FreeBoss();
+		// the state stays for the next run, drop everything this one
+		// referenced and let the gc have the _ENV with it
+		FreeCoroutine(coroutine);
+		coroutine = LUA_REFNIL;
+
+		// a ref freed twice corrupts the registry's free list for every
+		// later run
+		SDL_assert(AllRefsUnique(coro_pool));
+		for (int ref : coro_pool) {
+			luaL_unref(L, LUA_REGISTRYINDEX, ref);
+		}
+		coro_pool.clear();
 
-		lua_close(L); // crashes if L is null
+		luaL_unref(L, LUA_REGISTRYINDEX, env_ref);
+		env_ref = LUA_REFNIL;
+
+		lua_settop(L, 0);
 	}
 
 	bool CallLuaFunction(lua_State* L, int ref, instance_id id);
-	void UpdateCoroutine(lua_State* L, int* coroutine, instance_id id);
+	bool UpdateCoroutine(lua_State* L, int coroutine, instance_id id);
 
 #define PLAYER_DEATH_TIME      15.0f
 #define PLAYER_APPEAR_TIME     30.0f
@@ -79,7 +106,7 @@ namespace th {
 	}
 
 	void Stage::UpdatePlayer(float delta) {
-		const unsigned char* key = SDL_GetKeyboardState(nullptr);
+		unsigned short input = game.input;
 
 		player.hsp = 0.0f;
 		player.vsp = 0.0f;
@@ -89,15 +116,15 @@ namespace th {
 
 		switch (player.state) {
 			case PlayerState::Normal: {
-				player.focus = key[SDL_SCANCODE_LSHIFT];
+				player.focus = (input & INPUT_FOCUS) != 0;
 
 				float xmove = 0.0f;
 				float ymove = 0.0f;
 
-				if (key[SDL_SCANCODE_LEFT]) xmove -= 1.0f;
-				if (key[SDL_SCANCODE_RIGHT]) xmove += 1.0f;
-				if (key[SDL_SCANCODE_UP]) ymove -= 1.0f;
-				if (key[SDL_SCANCODE_DOWN]) ymove += 1.0f;
+				if (input & INPUT_LEFT) xmove -= 1.0f;
+				if (input & INPUT_RIGHT) xmove += 1.0f;
+				if (input & INPUT_UP) ymove -= 1.0f;
+				if (input & INPUT_DOWN) ymove += 1.0f;
 
 				float len = cpml::point_distance(0.0f, 0.0f, xmove, ymove);
 				if (len != 0.0f) {
@@ -113,7 +140,7 @@ namespace th {
 					(*character->shot_type)(&game, delta);
 				}
 
-				if (key[SDL_SCANCODE_X]) {
+				if (input & INPUT_BOMB) {
 					if (player.bomb_timer == 0.0f) {
 						if (scene.stats.bombs > 0) {
 							if (character->bomb) {
@@ -160,7 +187,7 @@ namespace th {
 				break;
 			}
 			case PlayerState::Dying: {
-				if (key[SDL_SCANCODE_X]) {
+				if (input & INPUT_BOMB) {
 					if ((PLAYER_DEATH_TIME - player.timer) < character->deathbomb_time) {
 						if (player.bomb_timer == 0.0f) {
 							if (scene.stats.bombs > 0) {
@@ -224,31 +251,102 @@ namespace th {
 		}
 	}
 
-	void Stage::CallCoroutines() {
-		UpdateCoroutine(L, &coroutine, -1);
+	void Stage::ScheduleCoroutine(instance_id id, unsigned int* wake, unsigned int delay) {
+		*wake = coro_frame + delay;
+		coro_wheel[*wake & (COROUTINE_WHEEL_SIZE - 1)].push_back({id, *wake});
+	}
 
-		if (boss_exists) {
-			UpdateCoroutine(L, &boss.coroutine, boss.id);
+	bool Stage::FindCoroutine(instance_id id, int** coroutine, unsigned int** wake) {
+		if (id == STAGE_COROUTINE_ID) {
+			*coroutine = &this->coroutine;
+			*wake = &coro_wake;
+			return true;
 		}
 
-		for (size_t i = 0, n = enemies.size(); i < n; i++) {
-			UpdateCoroutine(L, &enemies[i].coroutine, enemies[i].id);
+		switch (id >> TYPE_PART_SHIFT) {
+			case TYPE_BULLET: {
+				if (Bullet* bullet = FindBullet(id)) {
+					*coroutine = &bullet->coroutine;
+					*wake = &bullet->coro_wake;
+					return true;
+				}
+				break;
+			}
+			case TYPE_ENEMY: {
+				if (Enemy* enemy = FindEnemy(id)) {
+					*coroutine = &enemy->coroutine;
+					*wake = &enemy->coro_wake;
+					return true;
+				}
+				break;
+			}
+			case TYPE_BOSS: {
+				if (Boss* boss = FindBoss(id)) {
+					*coroutine = &boss->coroutine;
+					*wake = &boss->coro_wake;
+					return true;
+				}
+				break;
+			}
 		}
+		return false;
+	}
 
-		for (size_t i = 0, n = bullets.size(); i < n; i++) {
-			UpdateCoroutine(L, &bullets[i].coroutine, bullets[i].id);
+	void Stage::CallCoroutines() {
+		std::vector<CoroutineTimer>& slot = coro_wheel[coro_frame & (COROUTINE_WHEEL_SIZE - 1)];
+
+		// scripts can schedule new coroutines into this slot while it's
+		// walked, so it's indexed and compacted in place
+		size_t w = 0;
+		for (size_t i = 0; i < slot.size(); i++) {
+			CoroutineTimer timer = slot[i];
+			if (timer.wake != coro_frame) {
+				slot[w++] = timer;
+				continue;
+			}
+
+			int* coroutine;
+			unsigned int* wake;
+			if (!FindCoroutine(timer.id, &coroutine, &wake)) continue;
+			if (*coroutine == LUA_REFNIL || *wake != timer.wake) continue;
+
+			int ref = *coroutine;
+			coro_sleep = 0;
+			bool alive = UpdateCoroutine(L, ref, timer.id);
+
+			// the script may have grown the arrays or destroyed the object,
+			// then it's freed with the object
+			if (!FindCoroutine(timer.id, &coroutine, &wake) || *coroutine != ref) continue;
+
+			if (alive) {
+				ScheduleCoroutine(timer.id, wake, std::max(coro_sleep, 1u));
+			} else {
+				FreeCoroutine(ref);
+				*coroutine = LUA_REFNIL;
+			}
 		}
+		slot.resize(w);
+
+		coro_frame++;
 	}
 
 	void Stage::Update(float delta) {
+		TH_PROFILE_SCOPE("Stage::Update");
+
 		// update
 		{
-			UpdatePlayer(delta);
+			{
+				TH_PROFILE_SCOPE("player");
+				UpdatePlayer(delta);
+			}
 
 			if (boss_exists) {
+				TH_PROFILE_SCOPE("boss");
 				UpdateBoss(delta);
 			}
 
+			TH_PROFILE_SCOPE("bullet update");
+
 			for (Pickup& pickup : pickups) {
 				if (pickup.homing) {
 					float spd = 8.0f;
@@ -268,26 +366,33 @@ namespace th {
 				}
 			}
 
-			for (Bullet& bullet : bullets) {
-				switch (bullet.type) {
+			for (size_t i = 0, n = bullets.size(); i < n; i++) {
+				Bullet& bullet = bullets.data[i];
+				float length;
+				switch (bullets.type[i]) {
 					case ProjectileType::Lazer: {
 						if (bullet.lazer_timer < bullet.lazer_time) {
 							bullet.lazer_timer += delta;
-							bullet.length = cpml::lerp(0.0f, bullet.target_length, bullet.lazer_timer / bullet.lazer_time);
+							length = cpml::lerp(0.0f, bullet.target_length, bullet.lazer_timer / bullet.lazer_time);
 						} else {
-							bullet.length = bullet.target_length;
+							length = bullet.target_length;
 						}
 						break;
 					}
 					case ProjectileType::SLazer: {
 						if (bullet.lazer_timer < bullet.lazer_time) {
 							bullet.lazer_timer += delta;
-							bullet.length = 0.0f;
+							length = 0.0f;
 						} else {
-							bullet.length = bullet.target_length;
+							length = bullet.target_length;
 						}
 						break;
 					}
+					default: continue;
+				}
+				if (length != bullet.length) {
+					bullet.length = length;
+					bullets.UpdateLazerShape(i);
 				}
 			}
 
@@ -323,8 +428,8 @@ namespace th {
 
 						if (home) {
 							// @goofy
-							float hsp = cpml::lengthdir_x(bullet.spd, bullet.dir);
-							float vsp = cpml::lengthdir_y(bullet.spd, bullet.dir);
+							float hsp = bullet.spd * bullet.ux;
+							float vsp = bullet.spd * bullet.uy;
 							float dx = target_x - bullet.x;
 							float dy = target_y - bullet.y;
 							dx = std::clamp(dx, -12.0f, 12.0f);
@@ -332,7 +437,7 @@ namespace th {
 							hsp = cpml::approach(hsp, dx, 1.5f * delta);
 							vsp = cpml::approach(vsp, dy, 1.5f * delta);
 							bullet.spd = cpml::point_distance(0.0f, 0.0f, hsp, vsp);
-							bullet.dir = cpml::point_direction(0.0f, 0.0f, hsp, vsp);
+							SetDir(bullet, cpml::point_direction(0.0f, 0.0f, hsp, vsp));
 
 							//float target_dir = cpml::point_direction(bullet.x, bullet.y, target_x, target_y);
 							//bullet.dir += cpml::angle_difference(target_dir, bullet.dir) / 20.0f;
@@ -349,12 +454,28 @@ namespace th {
 
 		// physics
 		{
-			float physics_update_rate = 1.0f / 300.0f; // 300 fps
-			float physics_timer = delta * /*g_stage->gameplay_delta*/1.0f;
-			while (physics_timer > 0.0f) {
-				float pdelta = std::min(physics_timer, physics_update_rate * 60.0f);
-				PhysicsUpdate(pdelta);
-				physics_timer -= pdelta;
+			TH_PROFILE_SCOPE("physics");
+
+			for (size_t i = 0, n = bullets.size(); i < n; i++) {
+				bullets.UpdateMove(i);
+			}
+
+			bullet_grid.cells_visited = 0;
+			bullet_grid.narrowphase_tests = 0;
+
+			if (game.substep_physics) {
+				float physics_update_rate = 1.0f / 300.0f; // 300 fps
+				float physics_timer = delta * /*g_stage->gameplay_delta*/1.0f;
+				while (physics_timer > 0.0f) {
+					float pdelta = std::min(physics_timer, physics_update_rate * 60.0f);
+					TH_PROFILE_SCOPE("physics substep");
+					PhysicsUpdate(pdelta);
+					physics_timer -= pdelta;
+				}
+			} else {
+				// collide along this frame's motion, then move
+				CollideObjects(delta, true);
+				MoveObjects(delta);
 			}
 		}
 
@@ -362,34 +483,22 @@ namespace th {
 		{
 			coro_update_timer += delta;
 			while (coro_update_timer >= 1.0f) {
+				TH_PROFILE_SCOPE("coroutines");
 				CallCoroutines();
 				coro_update_timer -= 1.0f;
 			}
 
+			TH_PROFILE_SCOPE("enemy callbacks");
+
 			for (size_t i = 0, n = enemies.size(); i < n; i++) {
+				if (enemies[i].dead) continue;
 				CallLuaFunction(L, enemies[i].update_callback, enemies[i].id);
 			}
 		}
 
 		// cleanup
 		{
-			for (auto enemy = enemies.begin(); enemy != enemies.end();) {
-				if (enemy->dead) {
-					FreeEnemy(*enemy);
-					enemy = enemies.erase(enemy);
-					continue;
-				}
-				++enemy;
-			}
-
-			for (auto bullet = bullets.begin(); bullet != bullets.end();) {
-				if (bullet->dead) {
-					FreeBullet(*bullet);
-					bullet = bullets.erase(bullet);
-					continue;
-				}
-				++bullet;
-			}
+			TH_PROFILE_SCOPE("cleanup");
 
 			if (player.dead) {
 				CreatePlayer(true);
@@ -404,75 +513,73 @@ namespace th {
 		}
 
 		// late update
+		// Everything killed this frame was only marked dead; dead and
+		// off-screen objects are removed here in one pass per array.
 		{
+			TH_PROFILE_SCOPE("late update");
+
 			player.x = std::clamp(player.x, 0.0f, (float)PLAY_AREA_W - 1.0f);
 			player.y = std::clamp(player.y, 0.0f, (float)PLAY_AREA_H - 1.0f);
 
-			for (auto bullet = bullets.begin(); bullet != bullets.end();) {
-				float x = bullet->x;
-				float y = bullet->y;
-				if (x < 0.0f || x >= (float)PLAY_AREA_W || y < 0.0f || y >= (float)PLAY_AREA_H) {
-					FreeBullet(*bullet);
-					bullet = bullets.erase(bullet);
-					continue;
-				}
-				bullet->lifetime += delta;
-				if (bullet->lifetime > 60.0f * 60.0f) {
-					FreeBullet(*bullet);
-					bullet = bullets.erase(bullet);
-					continue;
-				}
-				if (bullet->type == ProjectileType::SLazer) {
-					if (bullet->lifetime >= bullet->lazer_lifetime) {
-						FreeBullet(*bullet);
-						bullet = bullets.erase(bullet);
-						continue;
+			bullet_cull.resize(bullets.size());
+			game.jobs.ParallelFor(bullets.size(), 2048, [&](size_t begin, size_t end, int worker) {
+				for (size_t i = begin; i < end; i++) {
+					float x = bullets.x[i];
+					float y = bullets.y[i];
+					bool cull = false;
+					if (bullets.data[i].dead) {
+						cull = true;
+					} else if (x < 0.0f || x >= (float)PLAY_AREA_W || y < 0.0f || y >= (float)PLAY_AREA_H) {
+						cull = true;
+					} else {
+						bullets.lifetime[i] += delta;
+						if (bullets.lifetime[i] > 60.0f * 60.0f) {
+							cull = true;
+						} else if (bullets.type[i] == ProjectileType::SLazer) {
+							cull = (bullets.lifetime[i] >= bullets.data[i].lazer_lifetime);
+						}
 					}
+					bullet_cull[i] = cull;
 				}
-				++bullet;
-			}
+			});
 
-			for (auto pickup = pickups.begin(); pickup != pickups.end();) {
-				float x = pickup->x;
-				float y = pickup->y;
-				if (x < 0.0f || x >= (float)PLAY_AREA_W || y < -50.0f || y >= (float)PLAY_AREA_H) {
-					pickup = pickups.erase(pickup);
-					continue;
-				}
-				++pickup;
-			}
+			CompactBullets();
 
-			for (auto b = player_bullets.begin(); b != player_bullets.end();) {
-				float x = b->x;
-				float y = b->y;
-				if (x < 0.0f || x >= (float)PLAY_AREA_W || y < 0.0f || y >= (float)PLAY_AREA_H) {
-					b = player_bullets.erase(b);
-					continue;
-				}
-				++b;
-			}
+			pickups.erase(std::remove_if(pickups.begin(), pickups.end(), [](const Pickup& pickup) {
+				float x = pickup.x;
+				float y = pickup.y;
+				return pickup.dead || x < 0.0f || x >= (float)PLAY_AREA_W || y < -50.0f || y >= (float)PLAY_AREA_H;
+			}), pickups.end());
 
-			for (auto e = enemies.begin(); e != enemies.end();) {
-				float x = e->x;
-				float y = e->y;
-				if (x < 0.0f || x >= (float)PLAY_AREA_W || y < 0.0f || y >= (float)PLAY_AREA_H) {
-					FreeEnemy(*e);
-					e = enemies.erase(e);
-					continue;
-				}
-				++e;
+			player_bullets.erase(std::remove_if(player_bullets.begin(), player_bullets.end(), [](const PlayerBullet& b) {
+				float x = b.x;
+				float y = b.y;
+				return b.dead || x < 0.0f || x >= (float)PLAY_AREA_W || y < 0.0f || y >= (float)PLAY_AREA_H;
+			}), player_bullets.end());
+
+			enemy_cull.resize(enemies.size());
+			for (size_t i = 0, n = enemies.size(); i < n; i++) {
+				float x = enemies[i].x;
+				float y = enemies[i].y;
+				enemy_cull[i] = enemies[i].dead || x < 0.0f || x >= (float)PLAY_AREA_W || y < 0.0f || y >= (float)PLAY_AREA_H;
 			}
+
+			CompactEnemies();
 		}
 
 		// animate
 		{
+			TH_PROFILE_SCOPE("animate");
+
 			if (boss_exists) {
 				UpdateSpriteComponent(boss.sc, delta);
 			}
 
-			for (Enemy& enemy : enemies) {
-				UpdateSpriteComponent(enemy.sc, delta);
-			}
+			game.jobs.ParallelFor(enemies.size(), 256, [&](size_t begin, size_t end, int worker) {
+				for (size_t i = begin; i < end; i++) {
+					UpdateSpriteComponent(enemies[i].sc, delta);
+				}
+			});
 		}
 
 		{
@@ -507,6 +614,8 @@ namespace th {
 		}
 
 		{
+			TH_PROFILE_SCOPE("stage bg");
+
 			StageData* stage = GetStageData(game.stage_index);
 			if (stage->update) {
 				(*stage->update)(&game, stage_memory, spellcard_bg_alpha < 1.0f, delta);
@@ -531,8 +640,8 @@ namespace th {
 
 	template <typename T>
 	static void MoveObject(T& object, float delta) {
-		object.x += cpml::lengthdir_x(object.spd, object.dir) * delta;
-		object.y += cpml::lengthdir_y(object.spd, object.dir) * delta;
+		object.x += object.spd * object.ux * delta;
+		object.y += object.spd * object.uy * delta;
 		object.spd += object.acc * delta;
 
 		if (object.spd < 0.0f) {
@@ -540,93 +649,282 @@ namespace th {
 		}
 	}
 
-	static bool PlayerVsBullet(Player& player, float player_radius, Bullet& bullet) {
-		switch (bullet.type) {
+	// how far an object moves in one step of delta
+	template <typename Object>
+	static float MotionX(Object& object, float delta) { return object.spd * object.ux * delta; }
+	template <typename Object>
+	static float MotionY(Object& object, float delta) { return object.spd * object.uy * delta; }
+
+	static float BulletMotionX(BulletArray& bullets, size_t i, float delta) { return bullets.move[i] ? bullets.spd[i] * bullets.ux[i] * delta : 0.0f; }
+	static float BulletMotionY(BulletArray& bullets, size_t i, float delta) { return bullets.move[i] ? bullets.spd[i] * bullets.uy[i] * delta : 0.0f; }
+
+	// (vx, vy) is the player's motion relative to the bullet, zero for an overlap test
+	static bool PlayerVsBullet(Player& player, float player_radius, float vx, float vy, BulletArray& bullets, size_t i, float* t) {
+		switch (bullets.type[i]) {
 			case ProjectileType::Bullet: {
-				return cpml::circle_vs_circle(player.x, player.y, player_radius, bullet.x, bullet.y, bullet.radius);
+				return cpml::swept_circle_vs_circle(player.x, player.y, player_radius, vx, vy, bullets.x[i], bullets.y[i], bullets.radius[i], t);
 			}
 			case ProjectileType::Lazer:
 			case ProjectileType::SLazer: {
-				float rect_center_x = bullet.x + cpml::lengthdir_x(bullet.length / 2.0f, bullet.dir);
-				float rect_center_y = bullet.y + cpml::lengthdir_y(bullet.length / 2.0f, bullet.dir);
-				return cpml::circle_vs_rotated_rect(player.x, player.y, player_radius, rect_center_x, rect_center_y, bullet.thickness, bullet.length, bullet.dir);
+				Bullet& bullet = bullets.data[i];
+				float rect_center_x = bullets.x[i] + bullet.center_dx;
+				float rect_center_y = bullets.y[i] + bullet.center_dy;
+
+				// reject by the laser's aabb against the circle's swept aabb
+				if (player.x + std::min(vx, 0.0f) - player_radius > rect_center_x + bullet.extent_x) return false;
+				if (player.x + std::max(vx, 0.0f) + player_radius < rect_center_x - bullet.extent_x) return false;
+				if (player.y + std::min(vy, 0.0f) - player_radius > rect_center_y + bullet.extent_y) return false;
+				if (player.y + std::max(vy, 0.0f) + player_radius < rect_center_y - bullet.extent_y) return false;
+
+				// dsin(dir) is -uy, dcos(dir) is ux
+				return cpml::swept_circle_vs_rotated_rect_sc(player.x, player.y, player_radius, vx, vy, rect_center_x, rect_center_y, bullet.thickness, bullet.length, -bullets.uy[i], bullets.ux[i], t);
 			}
 		}
 		return false;
 	}
 
-	void Stage::PhysicsUpdate(float delta) {
-		{
-			player.x += player.hsp * delta;
-			player.y += player.vsp * delta;
+	static int GridCoord(float v, float size, int cells) {
+		v = std::clamp(v, 0.0f, size - 1.0f);
+		return std::min((int)v / BULLET_GRID_CELL_SIZE, cells - 1);
+	}
 
-			if (boss_exists) {
-				MoveObject(boss, delta);
-			}
+	// bullets are inserted along their motion over delta
+	void Stage::BuildBulletGrid(float delta) {
+		BulletGrid& grid = bullet_grid;
+		size_t n = bullets.size();
 
-			for (Enemy& enemy : enemies) {
-				MoveObject(enemy, delta);
+		grid.rects.resize(n);
+
+		for (int w = 0; w < game.jobs.GetWorkerCount(); w++) {
+			grid.worker_max_radius[w] = 0.0f;
+		}
+
+		// cell rects in parallel, then a serial counting sort
+		game.jobs.ParallelFor(n, 1024, [&](size_t begin, size_t end, int worker) {
+			for (size_t i = begin; i < end; i++) {
+				float x0, y0, x1, y1;
+				if (bullets.type[i] == ProjectileType::Bullet) {
+					x0 = x1 = bullets.x[i];
+					y0 = y1 = bullets.y[i];
+					grid.worker_max_radius[worker] = std::max(grid.worker_max_radius[worker], bullets.radius[i]);
+				} else {
+					const Bullet& bullet = bullets.data[i];
+					float cx = bullets.x[i] + bullet.center_dx;
+					float cy = bullets.y[i] + bullet.center_dy;
+					x0 = cx - bullet.extent_x;
+					y0 = cy - bullet.extent_y;
+					x1 = cx + bullet.extent_x;
+					y1 = cy + bullet.extent_y;
+				}
+
+				float dx = BulletMotionX(bullets, i, delta);
+				float dy = BulletMotionY(bullets, i, delta);
+				x0 += std::min(dx, 0.0f);
+				y0 += std::min(dy, 0.0f);
+				x1 += std::max(dx, 0.0f);
+				y1 += std::max(dy, 0.0f);
+
+				BulletGrid::CellRect& r = grid.rects[i];
+				r.x0 = (unsigned char)GridCoord(x0, (float)PLAY_AREA_W, BULLET_GRID_W);
+				r.y0 = (unsigned char)GridCoord(y0, (float)PLAY_AREA_H, BULLET_GRID_H);
+				r.x1 = (unsigned char)GridCoord(x1, (float)PLAY_AREA_W, BULLET_GRID_W);
+				r.y1 = (unsigned char)GridCoord(y1, (float)PLAY_AREA_H, BULLET_GRID_H);
 			}
+		});
 
-			for (Bullet& bullet : bullets) {
-				switch (bullet.type) {
-					case ProjectileType::Lazer:
-					case ProjectileType::SLazer: {
-						if (bullet.lazer_timer >= bullet.lazer_time) {
-							MoveObject(bullet, delta);
-						}
-						break;
-					}
-					default: {
-						MoveObject(bullet, delta);
-						break;
-					}
+		grid.max_radius = 0.0f;
+		for (int w = 0; w < game.jobs.GetWorkerCount(); w++) {
+			grid.max_radius = std::max(grid.max_radius, grid.worker_max_radius[w]);
+		}
+
+		int count[BULLET_GRID_W * BULLET_GRID_H] = {};
+
+		for (size_t i = 0; i < n; i++) {
+			const BulletGrid::CellRect& r = grid.rects[i];
+			for (int cy = r.y0; cy <= r.y1; cy++) {
+				for (int cx = r.x0; cx <= r.x1; cx++) {
+					count[cx + cy * BULLET_GRID_W]++;
 				}
 			}
+		}
 
-			for (Pickup& pickup : pickups) {
-				pickup.x += pickup.hsp * delta;
-				pickup.y += pickup.vsp * delta;
+		int total = 0;
+		for (int c = 0; c < BULLET_GRID_W * BULLET_GRID_H; c++) {
+			grid.cell_start[c] = total;
+			total += count[c];
+			count[c] = grid.cell_start[c];
+		}
+		grid.cell_start[BULLET_GRID_W * BULLET_GRID_H] = total;
+
+		grid.entries.resize(total);
+
+		for (size_t i = 0; i < n; i++) {
+			const BulletGrid::CellRect& r = grid.rects[i];
+			for (int cy = r.y0; cy <= r.y1; cy++) {
+				for (int cx = r.x0; cx <= r.x1; cx++) {
+					grid.entries[count[cx + cy * BULLET_GRID_W]++] = (unsigned int)i;
+				}
 			}
+		}
+	}
 
-			for (PlayerBullet& b : player_bullets) {
-				MoveObject(b, delta);
+	// Collects the rows of bullets that may touch the circle into
+	// bullet_grid.candidates, deduplicated and in ascending order.
+	void Stage::QueryBulletGrid(float x, float y, float dx, float dy, float radius) {
+		BulletGrid& grid = bullet_grid;
+		grid.candidates.clear();
+
+		float reach = radius + grid.max_radius;
+		int x0 = GridCoord(x + std::min(dx, 0.0f) - reach, (float)PLAY_AREA_W, BULLET_GRID_W);
+		int y0 = GridCoord(y + std::min(dy, 0.0f) - reach, (float)PLAY_AREA_H, BULLET_GRID_H);
+		int x1 = GridCoord(x + std::max(dx, 0.0f) + reach, (float)PLAY_AREA_W, BULLET_GRID_W);
+		int y1 = GridCoord(y + std::max(dy, 0.0f) + reach, (float)PLAY_AREA_H, BULLET_GRID_H);
+
+		for (int cy = y0; cy <= y1; cy++) {
+			for (int cx = x0; cx <= x1; cx++) {
+				int c = cx + cy * BULLET_GRID_W;
+				grid.candidates.insert(grid.candidates.end(), grid.entries.begin() + grid.cell_start[c], grid.entries.begin() + grid.cell_start[c + 1]);
+				grid.cells_visited++;
 			}
 		}
 
+		// lasers can be in several cells, and rows must be visited in order
+		// so that the same bullet wins as without the grid
+		std::sort(grid.candidates.begin(), grid.candidates.end());
+		grid.candidates.erase(std::unique(grid.candidates.begin(), grid.candidates.end()), grid.candidates.end());
+	}
+
+	// legacy fixed-step mode: move, then test overlaps at the new positions
+	void Stage::PhysicsUpdate(float delta) {
+		MoveObjects(delta);
+		CollideObjects(delta, false);
+	}
+
+	void Stage::MoveObjects(float delta) {
+		player.x += player.hsp * delta;
+		player.y += player.vsp * delta;
+
+		if (boss_exists) {
+			MoveObject(boss, delta);
+		}
+
+		for (Enemy& enemy : enemies) {
+			MoveObject(enemy, delta);
+		}
+
+		game.jobs.ParallelFor(bullets.size(), 2048, [&](size_t begin, size_t end, int worker) {
+			IntegrateBullets(game.kinematics, end - begin, &bullets.x[begin], &bullets.y[begin], &bullets.spd[begin], &bullets.acc[begin], &bullets.ux[begin], &bullets.uy[begin], &bullets.move[begin], delta);
+		});
+
+		for (Pickup& pickup : pickups) {
+			pickup.x += pickup.hsp * delta;
+			pickup.y += pickup.vsp * delta;
+		}
+
+		for (PlayerBullet& b : player_bullets) {
+			MoveObject(b, delta);
+		}
+	}
+
+	// With swept set, objects are at the start of a step of delta and every
+	// test covers the motion over that step; the bullet that reaches the
+	// player first is the one that hits. Otherwise the tests are plain overlaps.
+	void Stage::CollideObjects(float delta, bool swept) {
+		float step = swept ? delta : 0.0f;
+
 		{
 			CharacterData* character = GetCharacterData(game.player_character);
+			float player_dx = player.hsp * step;
+			float player_dy = player.vsp * step;
 
 			// player vs bullet
-			for (auto bullet = bullets.begin(); bullet != bullets.end();) {
-				if (PlayerVsBullet(player, character->graze_radius, *bullet)) {
-					if (player.state == PlayerState::Normal) {
-						if (!bullet->grazed) {
-							scene.GetGraze(1);
-							PlaySound("se_graze.wav");
-							bullet->grazed = true;
-						}
+			BuildBulletGrid(step);
+			QueryBulletGrid(player.x, player.y, player_dx, player_dy, std::max(character->graze_radius, player.radius));
+
+			bool vulnerable = (player.state == PlayerState::Normal && player.iframes == 0.0f);
+			bool can_graze = (player.state == PlayerState::Normal);
+
+			const std::vector<unsigned int>& candidates = bullet_grid.candidates;
+			int workers = game.jobs.GetWorkerCount();
+			for (int w = 0; w < workers; w++) {
+				contacts[w].clear();
+				worker_tests[w] = 0;
+			}
+
+			game.jobs.ParallelFor(candidates.size(), 64, [&](size_t begin, size_t end, int worker) {
+				for (size_t c = begin; c < end; c++) {
+					unsigned int i = candidates[c];
+					if (bullets.data[i].dead) continue;
+
+					float vx = player_dx - BulletMotionX(bullets, i, step);
+					float vy = player_dy - BulletMotionY(bullets, i, step);
+					float t = 0.0f;
+
+					PlayerBulletContact contact{i, false, false, 0.0f};
+					if (can_graze && !bullets.data[i].grazed) {
+						contact.graze = PlayerVsBullet(player, character->graze_radius, vx, vy, bullets, i, &t);
+						worker_tests[worker]++;
+					}
+					if (vulnerable) {
+						contact.hit = PlayerVsBullet(player, player.radius, vx, vy, bullets, i, &t);
+						contact.t = t;
+						worker_tests[worker]++;
+					}
+
+					if (contact.graze || contact.hit) {
+						contacts[worker].push_back(contact);
 					}
 				}
+			});
 
-				if (PlayerVsBullet(player, player.radius, *bullet)) {
-					if (player.state == PlayerState::Normal) {
-						if (player.iframes == 0.0f) {
-							player.state = PlayerState::Dying;
-							player.timer = PLAYER_DEATH_TIME;
-							PlaySound("se_pichuun.wav");
-							bullets.erase(bullet);
-							break;
-						}
+			// chunks are handed out in order, but which worker ran which
+			// chunk is not, so merge by row
+			for (int w = 1; w < workers; w++) {
+				contacts[0].insert(contacts[0].end(), contacts[w].begin(), contacts[w].end());
+			}
+			std::sort(contacts[0].begin(), contacts[0].end(), [](const PlayerBulletContact& a, const PlayerBulletContact& b) {
+				return a.row < b.row;
+			});
+
+			for (int w = 0; w < workers; w++) {
+				bullet_grid.narrowphase_tests += worker_tests[w];
+			}
+
+			ssize hit = -1;
+			float hit_t = 0.0f;
+
+			for (const PlayerBulletContact& contact : contacts[0]) {
+				if (contact.graze) {
+					scene.GetGraze(1);
+					PlaySound(SND_GRAZE);
+					bullets.data[contact.row].grazed = true;
+				}
+
+				if (contact.hit) {
+					if (hit < 0 || contact.t < hit_t) {
+						hit = (ssize)contact.row;
+						hit_t = contact.t;
+					}
+					// every overlap is at t = 0, the first row wins as before
+					if (!swept) {
+						break;
 					}
 				}
+			}
 
-				++bullet;
+			if (hit >= 0) {
+				player.state = PlayerState::Dying;
+				player.timer = PLAYER_DEATH_TIME;
+				PlaySound(SND_PICHUUN);
+				bullets.data[hit].dead = true;
 			}
 
 			// player vs pickup
-			for (auto pickup = pickups.begin(); pickup != pickups.end();) {
-				if (cpml::circle_vs_circle(player.x, player.y, character->graze_radius, pickup->x, pickup->y, pickup->radius)) {
+			for (auto pickup = pickups.begin(); pickup != pickups.end(); ++pickup) {
+				if (pickup->dead) continue;
+
+				float t;
+				if (cpml::swept_circle_vs_circle(player.x, player.y, character->graze_radius, player_dx - pickup->hsp * step, player_dy - pickup->vsp * step, pickup->x, pickup->y, pickup->radius, &t)) {
 					if (player.state == PlayerState::Normal) {
 						switch (pickup->type) {
 							case PICKUP_POWER:
@@ -640,59 +938,66 @@ namespace th {
 							case PICKUP_1UP:        scene.GetLives(1);         break;
 							case PICKUP_SCORE:      scene.GetScore(10);        break;
 						}
-						PlaySound("se_item.wav");
-						pickup = pickups.erase(pickup);
-						continue;
+						PlaySound(SND_ITEM);
+						pickup->dead = true;
 					}
 				}
-				++pickup;
 			}
 
 			// boss vs bullet
 			if (boss_exists) {
-				for (auto bullet = player_bullets.begin(); bullet != player_bullets.end();) {
-					if (cpml::circle_vs_circle(boss.x, boss.y, boss.radius, bullet->x, bullet->y, bullet->radius)) {
-						PlaySound("se_enemy_hit.wav");
+				float boss_dx = MotionX(boss, step);
+				float boss_dy = MotionY(boss, step);
+				for (auto bullet = player_bullets.begin(); bullet != player_bullets.end(); ++bullet) {
+					if (bullet->dead) continue;
+
+					float t;
+					float vx = boss_dx - MotionX(*bullet, step);
+					float vy = boss_dy - MotionY(*bullet, step);
+					if (cpml::swept_circle_vs_circle(boss.x, boss.y, boss.radius, vx, vy, bullet->x, bullet->y, bullet->radius, &t)) {
+						PlaySound(SND_ENEMY_HIT);
 						if (boss.state == BossState::Normal) {
 							boss.hp -= bullet->dmg;
 							if (boss.hp <= 0.0f) {
+								bullet->dead = true;
 								EndBossPhase();
-								player_bullets.erase(bullet);
 								break;
 							}
 						}
-						bullet = player_bullets.erase(bullet);
-						continue;
+						bullet->dead = true;
 					}
-					++bullet;
 				}
 			}
 
 			// enemy vs bullet
 			// @goofy
 			for (size_t i = 0, n = enemies.size(); i < n; i++) {
+				if (enemies[i].dead) continue;
+
 				bool enemy_dead = false;
-				for (auto bullet = player_bullets.begin(); bullet != player_bullets.end();) {
-					if (cpml::circle_vs_circle(enemies[i].x, enemies[i].y, enemies[i].radius, bullet->x, bullet->y, bullet->radius)) {
+				float enemy_dx = MotionX(enemies[i], step);
+				float enemy_dy = MotionY(enemies[i], step);
+				for (auto bullet = player_bullets.begin(); bullet != player_bullets.end(); ++bullet) {
+					if (bullet->dead) continue;
+
+					float t;
+					float vx = enemy_dx - MotionX(*bullet, step);
+					float vy = enemy_dy - MotionY(*bullet, step);
+					if (cpml::swept_circle_vs_circle(enemies[i].x, enemies[i].y, enemies[i].radius, vx, vy, bullet->x, bullet->y, bullet->radius, &t)) {
 						enemies[i].hp -= bullet->dmg;
-						bullet = player_bullets.erase(bullet);
-						PlaySound("se_enemy_hit.wav");
+						bullet->dead = true;
+						PlaySound(SND_ENEMY_HIT);
 						if (enemies[i].hp <= 0.0f) {
-							PlaySound("se_enemy_die.wav");
+							PlaySound(SND_ENEMY_DIE);
 							enemy_dead = true;
 							break;
 						}
-						continue;
 					}
-					++bullet;
 				}
 				if (enemy_dead) {
 					CallLuaFunction(L, enemies[i].death_callback, enemies[i].id);
 
-					FreeEnemy(enemies[i]);
-					enemies.erase(enemies.begin() + i);
-					i--;
-					n--;
+					enemies[i].dead = true;
 				}
 			}
 		}
@@ -707,7 +1012,7 @@ namespace th {
 		float dist = cpml::point_distance(object.x, object.y, target_x, target_y);
 		object.spd = sqrtf(dist * acc * 2.0f);
 		object.acc = -acc;
-		object.dir = cpml::point_direction(object.x, object.y, target_x, target_y);
+		SetDir(object, cpml::point_direction(object.x, object.y, target_x, target_y));
 	}
 
 	void Stage::StartBossPhase() {
@@ -724,25 +1029,24 @@ namespace th {
 		}
 
 		if (phase->type == PHASE_SPELLCARD) {
-			PlaySound("se_spellcard.wav");
+			PlaySound(SND_SPELLCARD);
 		}
 	}
 
 	bool Stage::EndBossPhase() {
-		for (Bullet& bullet : bullets) {
-			CreatePickup(bullet.x, bullet.y, PICKUP_SCORE);
-			FreeBullet(bullet);
+		for (size_t i = 0, n = bullets.size(); i < n; i++) {
+			CreatePickup(bullets.x[i], bullets.y[i], PICKUP_SCORE);
+			FreeBullet(bullets.data[i]);
 		}
-		bullets.clear();
+		bullets.Clear();
+		bullet_slots.Clear();
 
 		for (Pickup& pickup : pickups) {
 			pickup.homing = true;
 		}
 
-		if (boss.coroutine != LUA_REFNIL) {
-			luaL_unref(L, LUA_REGISTRYINDEX, boss.coroutine);
-			boss.coroutine = LUA_REFNIL;
-		}
+		FreeCoroutine(boss.coroutine);
+		boss.coroutine = LUA_REFNIL;
 
 		BossData* data = GetBossData(boss.type_index);
 		PhaseData* phase = GetPhaseData(data, boss.phase_index);
@@ -765,26 +1069,51 @@ namespace th {
 				boss.phase_index++;
 				StartBossPhase();
 			}
-			PlaySound("se_enemy_die.wav");
+			PlaySound(SND_ENEMY_DIE);
 		} else {
 			for (Pickup& pickup : pickups) {
 				pickup.homing = true;
 			}
 
 			if (data->type == BOSS_BOSS) {
-				PlaySound("se_boss_die.wav");
+				PlaySound(SND_BOSS_DIE);
 				ScreenShake(6.0f, 120.0f);
 			} else {
-				PlaySound("se_enemy_die.wav");
+				PlaySound(SND_ENEMY_DIE);
 			}
 
 			FreeBoss();
 			boss_exists = false;
 		}
 
+		// everything the phase scripts made is garbage now, and the phase
+		// change hides the hitch
+		{
+			TH_PROFILE_SCOPE("lua full gc");
+			lua_gc(L, LUA_GCCOLLECT);
+			gc_step_took = 0.0;
+		}
+
 		return true;
 	}
 
+	void Stage::CollectGarbage(double budget) {
+		// a skipped frame shrinks the estimate, so one slow step (a major
+		// collection) can't keep the gc from ever running here again
+		if (budget <= 0.0 || budget < gc_step_took) {
+			gc_step_took *= 0.9;
+			return;
+		}
+
+		TH_PROFILE_SCOPE("lua gc");
+
+		// in generational mode one step is a whole young collection
+		Uint64 start = SDL_GetPerformanceCounter();
+		lua_gc(L, LUA_GCSTEP, 0);
+		double took = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+		gc_step_took += (took - gc_step_took) * 0.25;
+	}
+
 	void Stage::UpdateBoss(float delta) {
 		switch (boss.state) {
 			case BossState::Normal: {
@@ -805,8 +1134,11 @@ namespace th {
 					PhaseData* phase = GetPhaseData(data, boss.phase_index);
 
 					boss.state = BossState::Normal;
-					lua_getglobal(L, phase->script);
-					boss.coroutine = CreateCoroutine(L, L);
+					PushStageGlobal(phase->script);
+					boss.coroutine = CreateCoroutine(L);
+					if (boss.coroutine != LUA_REFNIL) {
+						ScheduleCoroutine(boss.id, &boss.coro_wake, 0);
+					}
 				}
 				break;
 			}
@@ -828,17 +1160,15 @@ namespace th {
 			}
 		}
 
-		if (game.debug) {
-			if (game.key_pressed[SDL_SCANCODE_B]) {
-				EndBossPhase();
+		if (game.input & INPUT_DEBUG_END_PHASE) {
+			EndBossPhase();
 
-				if (boss_exists) {
-					//if (!IsKeyDown(KEY_LEFT_CONTROL)) {
-						if (boss.state == BossState::WaitingEnd) {
-							boss.wait_timer = 0.0f;
-						}
-					//}
-				}
+			if (boss_exists) {
+				//if (!IsKeyDown(KEY_LEFT_CONTROL)) {
+					if (boss.state == BossState::WaitingEnd) {
+						boss.wait_timer = 0.0f;
+					}
+				//}
 			}
 		}
 	}
@@ -853,10 +1183,14 @@ namespace th {
 		x += screen_shake_x;
 		y += screen_shake_y;
 
-		DrawSprite(renderer, sprite, frame_index, x, y, angle, xscale, yscale, color);
+		game.sprite_batch.DrawSprite(sprite, frame_index, x, y, angle, xscale, yscale, color);
 	}
 
 	void Stage::Draw(SDL_Renderer* renderer, SDL_Texture* target, float delta) {
+		TH_PROFILE_SCOPE("Stage::Draw");
+
+		SpriteBatch& batch = game.sprite_batch;
+
 		SDL_SetRenderTarget(renderer, target);
 		{
 			SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
@@ -864,6 +1198,8 @@ namespace th {
 
 			// stage bg
 			{
+				TH_PROFILE_SCOPE("stage bg draw");
+
 				StageData* stage = GetStageData(game.stage_index);
 				if (stage->draw) {
 					(*stage->draw)(&game, renderer, stage_memory, spellcard_bg_alpha < 1.0f, delta);
@@ -872,7 +1208,7 @@ namespace th {
 
 			// spell card bg
 			if (spellcard_bg_alpha > 0.0f) {
-				SDL_Texture* texture = game.assets.GetTexture("CirnoSpellcardBG.png");
+				SDL_Texture* texture = game.assets.GetTexture(TEX_SPELLCARD_BG);
 				SDL_SetTextureScaleMode(texture, SDL_ScaleModeLinear);
 				SDL_SetTextureAlphaMod(texture, (unsigned char)(255.0f * spellcard_bg_alpha));
 				{
@@ -927,11 +1263,11 @@ namespace th {
 				DrawObject(renderer, player, 0.0f, -player.facing * xscale, yscale, color);
 
 				if (player.hitbox_alpha > 0.0f) {
-					SpriteData* sprite = game.assets.GetSprite("Hitbox");
+					SpriteData* sprite = game.assets.GetSprite(SPR_HITBOX);
 					unsigned char a = (unsigned char) (255.0f * player.hitbox_alpha);
 					float x = player.x + screen_shake_x;
 					float y = player.y + screen_shake_y;
-					DrawSprite(renderer, sprite, 0, x, y, -time, 1.0f, 1.0f, {255, 255, 255, a});
+					batch.DrawSprite(sprite, 0, x, y, -time, 1.0f, 1.0f, {255, 255, 255, a});
 				}
 			}
 
@@ -953,34 +1289,38 @@ namespace th {
 				}
 			}
 
-			for (Bullet& bullet : bullets) {
-				switch (bullet.type) {
+			for (size_t i = 0, n = bullets.size(); i < n; i++) {
+				Bullet& bullet = bullets.data[i];
+				float dir = bullets.dir[i];
+				float angle = 0.0f;
+				float xscale = 1.0f;
+				float yscale = 1.0f;
+				switch (bullets.type[i]) {
 					case ProjectileType::Lazer: {
-						float angle = bullet.dir + 90.0f;
-						float xscale = (bullet.thickness + 2.0f) / 16.0f;
-						float yscale = bullet.length / 16.0f;
-						DrawObject(renderer, bullet, angle, xscale, yscale);
+						angle = dir + 90.0f;
+						xscale = (bullet.thickness + 2.0f) / 16.0f;
+						yscale = bullet.length / 16.0f;
 						break;
 					}
 					case ProjectileType::SLazer: {
-						float angle = bullet.dir + 90.0f;
-						float xscale = (bullet.thickness + 2.0f) / 16.0f;
-						float yscale = bullet.target_length / 16.0f;
+						angle = dir + 90.0f;
+						xscale = (bullet.thickness + 2.0f) / 16.0f;
+						yscale = bullet.target_length / 16.0f;
 						if (bullet.lazer_timer < bullet.lazer_time) {
 							xscale = 2.0f / 16.0f;
 						}
-						DrawObject(renderer, bullet, angle, xscale, yscale);
 						break;
 					}
 					default: {
-						float angle = 0.0f;
 						if (bullet.rotate) {
-							angle = bullet.dir - 90.0f;
+							angle = dir - 90.0f;
 						}
-						DrawObject(renderer, bullet, angle);
 						break;
 					}
 				}
+				float x = bullets.x[i] + screen_shake_x;
+				float y = bullets.y[i] + screen_shake_y;
+				batch.DrawSprite(bullet.sc.sprite, (int)bullet.sc.frame_index, x, y, angle, xscale, yscale);
 			}
 
 			// GUI
@@ -993,7 +1333,7 @@ namespace th {
 						float x = pickup.x;
 						float y = 8.0f;
 						SDL_Color color{255, 255, 255, 192};
-						DrawSprite(renderer, sprite, frame_index, x, y, 0.0f, 1.0f, 1.0f, color);
+						batch.DrawSprite(sprite, frame_index, x, y, 0.0f, 1.0f, 1.0f, color);
 					}
 				}
 
@@ -1008,7 +1348,7 @@ namespace th {
 						char buf[2] = {'0' + data->phase_count - boss.phase_index - 1, 0};
 						int x = 8;
 						int y = 0;
-						DrawTextBitmap(renderer, game.assets.fntMain, buf, x, y);
+						batch.DrawTextBitmap(game.assets.fntMain, buf, x, y);
 					}
 
 					// healthbar
@@ -1018,6 +1358,7 @@ namespace th {
 						int healthbar_w = PLAY_AREA_W - 64 - 4;
 						int healthbar_h = 2;
 						int reduced_w = (int) ((float)healthbar_w * (boss.hp / phase->hp));
+						batch.Flush();
 						{
 							SDL_Rect rect{healthbar_x, healthbar_y + 1, reduced_w, healthbar_h};
 							SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
@@ -1037,60 +1378,50 @@ namespace th {
 						int x = PLAY_AREA_W - 2 * 15;
 						int y = 0;
 						if ((int)(boss.timer / 60.0f) < 10) x += 8;
-						DrawTextBitmap(renderer, game.assets.fntMain, buf, x, y);
+						batch.DrawTextBitmap(game.assets.fntMain, buf, x, y);
 					}
 
 					// boss name
 					{
-						SDL_Surface* surface = TTF_RenderText_Blended(game.assets.fntCirno, data->name, {255, 255, 255, 255});
-						SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-						{
-							SDL_SetTextureColorMod(texture, 0, 0, 0);
-							SDL_Rect dest{17, 17, surface->w, surface->h};
-							SDL_RenderCopy(renderer, texture, nullptr, &dest);
-						}
-						{
-							SDL_SetTextureColorMod(texture, 255, 255, 255);
-							SDL_Rect dest{16, 16, surface->w, surface->h};
-							SDL_RenderCopy(renderer, texture, nullptr, &dest);
-						}
-						SDL_DestroyTexture(texture);
-						SDL_FreeSurface(surface);
+						batch.DrawText(game.assets.fntCirnoGlyphs, data->name, 17, 17, {0, 0, 0, 255});
+						batch.DrawText(game.assets.fntCirnoGlyphs, data->name, 16, 16);
 					}
 
 					// phase name
 					if (phase->type == PHASE_SPELLCARD && boss.state != BossState::WaitingEnd) {
-						SDL_Surface* surface = TTF_RenderText_Blended(game.assets.fntCirno, phase->name, {255, 255, 255, 255});
-						SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-						{
-							SDL_SetTextureColorMod(texture, 0, 0, 0);
-							SDL_Rect dest{PLAY_AREA_W - 15 - surface->w, 17, surface->w, surface->h};
-							SDL_RenderCopy(renderer, texture, nullptr, &dest);
-						}
-						{
-							SDL_SetTextureColorMod(texture, 255, 255, 255);
-							SDL_Rect dest{PLAY_AREA_W - 16 - surface->w, 16, surface->w, surface->h};
-							SDL_RenderCopy(renderer, texture, nullptr, &dest);
-						}
-						SDL_DestroyTexture(texture);
-						SDL_FreeSurface(surface);
+						int w = MeasureText(game.assets.fntCirnoGlyphs, phase->name);
+						batch.DrawText(game.assets.fntCirnoGlyphs, phase->name, PLAY_AREA_W - 15 - w, 17, {0, 0, 0, 255});
+						batch.DrawText(game.assets.fntCirnoGlyphs, phase->name, PLAY_AREA_W - 16 - w, 16);
 					}
 				}
 			}
+
+			batch.Flush();
 		}
 		SDL_SetRenderTarget(renderer, nullptr);
 	}
 
-	Enemy& Stage::CreateEnemy() {
+	Enemy* Stage::CreateEnemy() {
+		if (enemy_slots.IsFull()) {
+			if (refused_spawns++ == 0) {
+				TH_LOG_ERROR("more than %d enemies, refusing spawns", SLOT_CAPACITY);
+			}
+			return nullptr;
+		}
 		Enemy& enemy = enemies.emplace_back();
-		enemy.id = (next_id++) | (TYPE_ENEMY << TYPE_PART_SHIFT);
-		return enemy;
+		enemy.id = enemy_slots.Add(TYPE_ENEMY, enemies.size() - 1);
+		return &enemy;
 	}
 
-	Bullet& Stage::CreateBullet() {
-		Bullet& bullet = bullets.emplace_back();
-		bullet.id = (next_id++) | (TYPE_BULLET << TYPE_PART_SHIFT);
-		return bullet;
+	Bullet* Stage::CreateBullet() {
+		if (bullet_slots.IsFull()) {
+			if (refused_spawns++ == 0) {
+				TH_LOG_ERROR("more than %d bullets, refusing spawns", SLOT_CAPACITY);
+			}
+			return nullptr;
+		}
+		size_t i = bullets.Add(bullet_slots.Add(TYPE_BULLET, bullets.size()));
+		return &bullets.data[i];
 	}
 
 	Player& Stage::CreatePlayer(bool from_death) {
@@ -1128,7 +1459,7 @@ namespace th {
 		pickup.y = y;
 		pickup.vsp = -1.5f;
 		pickup.radius = 8.0f;
-		pickup.sc.sprite = game.assets.GetSprite("Pickup");
+		pickup.sc.sprite = game.assets.GetSprite(SPR_PICKUP);
 		pickup.sc.frame_index = (float)type;
 		pickup.type = type;
 		return pickup;
@@ -1139,33 +1470,21 @@ namespace th {
 		return player_bullet;
 	}
 
-	typedef ptrdiff_t ssize;
-
-	template <typename T>
-	static T* BinarySearch(std::vector<T>& storage, instance_id id) {
-		ssize left = 0;
-		ssize right = (ssize)storage.size() - 1;
-
-		while (left <= right) {
-			ssize middle = (left + right) / 2;
-			if (storage[middle].id < id) {
-				left = middle + 1;
-			} else if (storage[middle].id > id) {
-				right = middle - 1;
-			} else {
-				return &storage[middle];
-			}
-		}
-
-		return nullptr;
-	}
-
+	// objects marked dead are gone as far as scripts are concerned
 	Enemy* Stage::FindEnemy(instance_id id) {
-		return BinarySearch(enemies, id);
+		ssize i = enemy_slots.Find(id);
+		if (i < 0 || enemies[i].dead) {
+			return nullptr;
+		}
+		return &enemies[i];
 	}
 
 	Bullet* Stage::FindBullet(instance_id id) {
-		return BinarySearch(bullets, id);
+		ssize i = bullet_slots.Find(id);
+		if (i < 0 || bullets.data[i].dead) {
+			return nullptr;
+		}
+		return &bullets.data[i];
 	}
 
 	Player* Stage::FindPlayer(instance_id id) {
@@ -1186,19 +1505,58 @@ namespace th {
 		return result;
 	}
 
+	// refs are reset so a second free is a no-op, a pooled thread
+	// must not go back to the pool twice
+
 	void Stage::FreeEnemy(Enemy& enemy) {
-		if (enemy.coroutine != LUA_REFNIL) luaL_unref(L, LUA_REGISTRYINDEX, enemy.coroutine);
+		FreeCoroutine(enemy.coroutine);
+		enemy.coroutine = LUA_REFNIL;
 		if (enemy.update_callback != LUA_REFNIL) luaL_unref(L, LUA_REGISTRYINDEX, enemy.update_callback);
+		enemy.update_callback = LUA_REFNIL;
 		if (enemy.death_callback != LUA_REFNIL) luaL_unref(L, LUA_REGISTRYINDEX, enemy.death_callback);
+		enemy.death_callback = LUA_REFNIL;
 	}
 
 	void Stage::FreeBullet(Bullet& bullet) {
-		if (bullet.coroutine != LUA_REFNIL) luaL_unref(L, LUA_REGISTRYINDEX, bullet.coroutine);
+		FreeCoroutine(bullet.coroutine);
+		bullet.coroutine = LUA_REFNIL;
 		if (bullet.update_callback != LUA_REFNIL) luaL_unref(L, LUA_REGISTRYINDEX, bullet.update_callback);
+		bullet.update_callback = LUA_REFNIL;
 	}
 
 	void Stage::FreeBoss() {
-		if (boss.coroutine != LUA_REFNIL) luaL_unref(L, LUA_REGISTRYINDEX, boss.coroutine);
+		FreeCoroutine(boss.coroutine);
+		boss.coroutine = LUA_REFNIL;
+	}
+
+	void Stage::CompactEnemies() {
+		for (size_t i = 0, w = 0, n = enemies.size(); i < n; i++) {
+			if (enemy_cull[i]) {
+				FreeEnemy(enemies[i]);
+				enemy_slots.Remove(enemies[i].id);
+				continue;
+			}
+			if (w != i) {
+				enemy_slots.Move(enemies[i].id, w);
+			}
+			w++;
+		}
+		CompactColumn(enemies, enemy_cull.data());
+	}
+
+	void Stage::CompactBullets() {
+		for (size_t i = 0, w = 0, n = bullets.size(); i < n; i++) {
+			if (bullet_cull[i]) {
+				FreeBullet(bullets.data[i]);
+				bullet_slots.Remove(bullets.id[i]);
+				continue;
+			}
+			if (w != i) {
+				bullet_slots.Move(bullets.id[i], w);
+			}
+			w++;
+		}
+		bullets.Compact(bullet_cull.data());
 	}
 
 }
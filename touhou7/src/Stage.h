@@ -2,6 +2,8 @@
 
 #include "Objects.h"
 
+#include "JobSystem.h"
+
 #include "xorshf96.h"
 
 #define PLAY_AREA_W 384
@@ -13,12 +15,56 @@
 #define PLAYER_STARTING_X ((float)PLAY_AREA_W / 2.0f)
 #define PLAYER_STARTING_Y 384.0f
 
+#define BULLET_GRID_CELL_SIZE 32
+#define BULLET_GRID_W (PLAY_AREA_W / BULLET_GRID_CELL_SIZE)
+#define BULLET_GRID_H (PLAY_AREA_H / BULLET_GRID_CELL_SIZE)
+
+#define COROUTINE_WHEEL_SIZE 256 // power of two
+#define STAGE_COROUTINE_ID ((instance_id)-1)
+#define COROUTINE_POOL_MAX 4096
+
 namespace th {
 
 	class Game;
 
 	class GameScene;
 
+	// Uniform grid over the play area used as the player vs bullet broadphase.
+	// Bullets are bucketed by their center, lasers go into every cell their
+	// bounding box overlaps. Rebuilt with a counting sort every physics step.
+	struct BulletGrid {
+		struct CellRect {
+			unsigned char x0, y0, x1, y1;
+		};
+
+		int cell_start[BULLET_GRID_W * BULLET_GRID_H + 1];
+		std::vector<unsigned int> entries; // bullet rows grouped by cell
+		std::vector<CellRect> rects; // per bullet row
+		std::vector<unsigned int> candidates;
+		float max_radius = 0.0f; // largest round bullet radius
+		float worker_max_radius[JOB_MAX_WORKERS];
+
+		// per frame
+		int cells_visited = 0;
+		int narrowphase_tests = 0;
+	};
+
+	// A parked coroutine. Entries whose wake doesn't match the object's
+	// coro_wake anymore are stale and get dropped.
+	struct CoroutineTimer {
+		instance_id id;
+		unsigned int wake;
+	};
+
+	// Result of a player vs bullet test, gathered per worker and applied on
+	// the main thread in row order.
+	struct PlayerBulletContact {
+		unsigned int row;
+		bool graze;
+		bool hit;
+		float t;
+	};
+
 	class Stage {
 	public:
 		Stage(Game& game, GameScene& scene) : game(game), scene(scene) {}
@@ -29,8 +75,9 @@ namespace th {
 		void Update(float delta);
 		void Draw(SDL_Renderer* renderer, SDL_Texture* target, float delta);
 
-		Enemy& CreateEnemy();
-		Bullet& CreateBullet();
+		// null once the slot map is full, the spawn is refused
+		Enemy* CreateEnemy();
+		Bullet* CreateBullet();
 		Player& CreatePlayer(bool from_death = false);
 		Boss& CreateBoss();
 		Pickup& CreatePickup(float x, float y, unsigned char type);
@@ -45,6 +92,22 @@ namespace th {
 		void FreeBullet(Bullet& bullet);
 		void FreeBoss();
 
+		// Coroutine threads are recycled: freed ones are reset and keep their
+		// registry slot, so scripted bullets don't make a new thread each.
+		// Pops the function from `from`.
+		int CreateCoroutine(lua_State* from);
+		void FreeCoroutine(int coroutine);
+
+
+		// Parks a coroutine in the timer wheel until `delay` ticks from now.
+		// 0 resumes it on the current tick, also when called from a script.
+		void ScheduleCoroutine(instance_id id, unsigned int* wake, unsigned int delay);
+
+		// Runs the Lua collector in the frame's spare time (seconds), if
+		// that's more than the last step took. The automatic collector
+		// stays on for frames without spare time.
+		void CollectGarbage(double budget);
+
 		void StartBossPhase();
 		bool EndBossPhase();
 
@@ -58,37 +121,69 @@ namespace th {
 		bool boss_exists = false;
 		Boss boss{};
 		std::vector<Enemy> enemies;
-		std::vector<Bullet> bullets;
+		BulletArray bullets;
+		BulletGrid bullet_grid;
 		std::vector<Pickup> pickups;
 		std::vector<PlayerBullet> player_bullets;
 
 		xorshf96 random;
-		lua_State* L = nullptr;
+		lua_State* L = nullptr; // Game::lua
 		float time = 0.0f;
 		float screen_shake_power = 0.0f;
 		float screen_shake_timer = 0.0f;
 		float screen_shake_time = 0.0f;
 		float screen_shake_x = 0.0f;
 		float screen_shake_y = 0.0f;
+		unsigned int coro_sleep = 0; // ticks asked for by wait() in the running coroutine
+		int coro_pool_hits = 0;
+		int coro_pool_misses = 0;
+		int refused_spawns = 0;
 
 	private:
 		Game& game;
 		GameScene& scene;
 
 		void InitLua();
+		void PushStageGlobal(const char* name);
 		void PhysicsUpdate(float delta);
+		void MoveObjects(float delta);
+		void CollideObjects(float delta, bool swept);
+		void BuildBulletGrid(float delta);
+		void QueryBulletGrid(float x, float y, float dx, float dy, float radius);
 		void CallCoroutines();
+		bool FindCoroutine(instance_id id, int** coroutine, unsigned int** wake);
 		void UpdateBoss(float delta);
 		void UpdateSpriteComponent(SpriteComponent& sc, float delta);
 		void UpdatePlayer(float delta);
 
+		// free and remove the flagged rows, keeping order
+		void CompactEnemies();
+		void CompactBullets();
+
 		template <typename Object>
 		void DrawObject(SDL_Renderer* renderer, Object& object, float angle = 0.0f, float xscale = 1.0f, float yscale = 1.0f, SDL_Color color = {255, 255, 255, 255});
 
-		instance_id next_id = 0;
+		SlotMap enemy_slots;
+		SlotMap bullet_slots;
+
+		// per-worker scratch for the parallel passes
+		std::vector<unsigned char> enemy_cull;
+		std::vector<unsigned char> bullet_cull;
+		std::vector<PlayerBulletContact> contacts[JOB_MAX_WORKERS];
+		int worker_tests[JOB_MAX_WORKERS];
 
+		int env_ref = LUA_REFNIL; // this run's _ENV, globals of the stage scripts
 		int coroutine = LUA_REFNIL;
+		unsigned int coro_wake = 0;
 		float coro_update_timer = 0.0f;
+
+		// parked coroutines by wake tick, waits longer than the wheel
+		// stay in their slot for more turns
+		std::vector<CoroutineTimer> coro_wheel[COROUTINE_WHEEL_SIZE];
+		unsigned int coro_frame = 0; // tick being resumed
+		std::vector<int> coro_pool; // refs of reset threads
+
+		double gc_step_took = 0.0; // moving average of a gc step, seconds
 		float spellcard_bg_alpha = 0.0f;
 
 		unsigned char* stage_memory = nullptr;
@@ -19,7 +19,7 @@ namespace th {
 
 		if (key[SDL_SCANCODE_RETURN] || key[SDL_SCANCODE_Z]) {
 			game.GoToScene(GAME_SCENE);
-			PlaySound("se_ok.wav");
+			PlaySound(SND_OK);
 		}
 		if (key[SDL_SCANCODE_1]) {
 			game.skip_to_midboss = 1;
@@ -28,10 +28,10 @@ namespace th {
 			game.skip_to_boss = 1;
 		}
 
-		if (game.key_pressed[SDL_SCANCODE_LEFT])  { game.stage_index--;      PlaySound("se_select.wav"); }
-		if (game.key_pressed[SDL_SCANCODE_RIGHT]) { game.stage_index++;      PlaySound("se_select.wav"); }
-		if (game.key_pressed[SDL_SCANCODE_UP])    { game.stage_index -= 100; PlaySound("se_select.wav"); }
-		if (game.key_pressed[SDL_SCANCODE_DOWN])  { game.stage_index += 100; PlaySound("se_select.wav"); }
+		if (game.key_pressed[SDL_SCANCODE_LEFT])  { game.stage_index--;      PlaySound(SND_SELECT); }
+		if (game.key_pressed[SDL_SCANCODE_RIGHT]) { game.stage_index++;      PlaySound(SND_SELECT); }
+		if (game.key_pressed[SDL_SCANCODE_UP])    { game.stage_index -= 100; PlaySound(SND_SELECT); }
+		if (game.key_pressed[SDL_SCANCODE_DOWN])  { game.stage_index += 100; PlaySound(SND_SELECT); }
 	}
 
 	void TitleScene::Draw(SDL_Renderer* renderer, SDL_Texture* target, float delta) {
@@ -0,0 +1,105 @@
+#include "bullet_kinematics.h"
+
+#include <SDL.h>
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+// msvc allows avx intrinsics in any function, gcc and clang need to be told
+#if defined(__GNUC__) || defined(__clang__)
+#define TH_TARGET_AVX __attribute__((target("avx")))
+#else
+#define TH_TARGET_AVX
+#endif
+
+namespace th {
+
+	KinematicsPath DetectKinematicsPath() {
+		if (SDL_HasAVX()) return KINEMATICS_AVX;
+		if (SDL_HasSSE2()) return KINEMATICS_SSE2;
+		return KINEMATICS_SCALAR;
+	}
+
+	const char* GetKinematicsPathName(KinematicsPath path) {
+		switch (path) {
+			case KINEMATICS_SCALAR: return "scalar";
+			case KINEMATICS_SSE2:   return "sse2";
+			case KINEMATICS_AVX:    return "avx";
+			case KINEMATICS_COUNT:  break;
+		}
+		return "?";
+	}
+
+	// also handles the tails of the vector loops
+	static void IntegrateScalar(size_t i, size_t n, float* x, float* y, float* spd, const float* acc, const float* ux, const float* uy, const unsigned int* move, float delta) {
+		for (; i < n; i++) {
+			if (!move[i]) continue;
+
+			x[i] += spd[i] * ux[i] * delta;
+			y[i] += spd[i] * uy[i] * delta;
+			spd[i] += acc[i] * delta;
+
+			if (spd[i] < 0.0f) {
+				spd[i] = 0.0f;
+			}
+		}
+	}
+
+	static size_t IntegrateSSE2(size_t n, float* x, float* y, float* spd, const float* acc, const float* ux, const float* uy, const unsigned int* move, float delta) {
+		__m128 d = _mm_set1_ps(delta);
+		__m128 zero = _mm_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			__m128 m = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(move + i)));
+			__m128 px = _mm_loadu_ps(x + i);
+			__m128 py = _mm_loadu_ps(y + i);
+			__m128 s = _mm_loadu_ps(spd + i);
+
+			__m128 nx = _mm_add_ps(px, _mm_mul_ps(_mm_mul_ps(s, _mm_loadu_ps(ux + i)), d));
+			__m128 ny = _mm_add_ps(py, _mm_mul_ps(_mm_mul_ps(s, _mm_loadu_ps(uy + i)), d));
+			// maxps returns the second operand on NaN and on equality, same as the scalar clamp
+			__m128 ns = _mm_max_ps(zero, _mm_add_ps(s, _mm_mul_ps(_mm_loadu_ps(acc + i), d)));
+
+			_mm_storeu_ps(x + i, _mm_or_ps(_mm_and_ps(m, nx), _mm_andnot_ps(m, px)));
+			_mm_storeu_ps(y + i, _mm_or_ps(_mm_and_ps(m, ny), _mm_andnot_ps(m, py)));
+			_mm_storeu_ps(spd + i, _mm_or_ps(_mm_and_ps(m, ns), _mm_andnot_ps(m, s)));
+		}
+		return i;
+	}
+
+	TH_TARGET_AVX
+	static size_t IntegrateAVX(size_t n, float* x, float* y, float* spd, const float* acc, const float* ux, const float* uy, const unsigned int* move, float delta) {
+		__m256 d = _mm256_set1_ps(delta);
+		__m256 zero = _mm256_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256 m = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*)(move + i)));
+			__m256 px = _mm256_loadu_ps(x + i);
+			__m256 py = _mm256_loadu_ps(y + i);
+			__m256 s = _mm256_loadu_ps(spd + i);
+
+			__m256 nx = _mm256_add_ps(px, _mm256_mul_ps(_mm256_mul_ps(s, _mm256_loadu_ps(ux + i)), d));
+			__m256 ny = _mm256_add_ps(py, _mm256_mul_ps(_mm256_mul_ps(s, _mm256_loadu_ps(uy + i)), d));
+			__m256 ns = _mm256_max_ps(zero, _mm256_add_ps(s, _mm256_mul_ps(_mm256_loadu_ps(acc + i), d)));
+
+			_mm256_storeu_ps(x + i, _mm256_blendv_ps(px, nx, m));
+			_mm256_storeu_ps(y + i, _mm256_blendv_ps(py, ny, m));
+			_mm256_storeu_ps(spd + i, _mm256_blendv_ps(s, ns, m));
+		}
+		return i;
+	}
+
+	void IntegrateBullets(KinematicsPath path, size_t n, float* x, float* y, float* spd, const float* acc, const float* ux, const float* uy, const unsigned int* move, float delta) {
+		size_t i = 0;
+		switch (path) {
+			case KINEMATICS_AVX:  i = IntegrateAVX(n, x, y, spd, acc, ux, uy, move, delta);  break;
+			case KINEMATICS_SSE2: i = IntegrateSSE2(n, x, y, spd, acc, ux, uy, move, delta); break;
+			case KINEMATICS_SCALAR:
+			default:              break; // all of it in the scalar loop below
+		}
+		IntegrateScalar(i, n, x, y, spd, acc, ux, uy, move, delta);
+	}
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace th {
+
+	enum KinematicsPath : int {
+		KINEMATICS_SCALAR,
+		KINEMATICS_SSE2,
+		KINEMATICS_AVX,
+
+		KINEMATICS_COUNT
+	};
+
+	// best path the cpu supports
+	KinematicsPath DetectKinematicsPath();
+
+	const char* GetKinematicsPathName(KinematicsPath path);
+
+	// For every row with move[i] set:
+	//   x += spd * ux * delta
+	//   y += spd * uy * delta
+	//   spd = max(spd + acc * delta, 0)
+	// ux, uy are lengthdir_x/y(1, dir), so this matches lengthdir(spd, dir) bit for bit.
+	void IntegrateBullets(KinematicsPath path, size_t n, float* x, float* y, float* spd, const float* acc, const float* ux, const float* uy, const unsigned int* move, float delta);
+
+}
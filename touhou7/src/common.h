@@ -10,8 +10,8 @@
 
 #define TH_SHOW_ERROR(fmt, ...)																\
 	do {																					\
-		bool fullscreen = Game::GetInstance().fullscreen;									\
-		if (fullscreen) {																	\
+		Game& _game = Game::GetInstance();													\
+		if (_game.fullscreen || _game.headless) {											\
 			printf("ERROR\n");																\
 			TH_LOG_ERROR(fmt "\n", __VA_ARGS__);											\
 		} else {																			\
@@ -76,12 +76,13 @@ namespace cpml {
 		return res;
 	}
 
-	inline bool circle_vs_rotated_rect(float circle_x, float circle_y, float circle_radius, float rect_center_x, float rect_center_y, float rect_w, float rect_h, float rect_dir) {
+	// takes dsin(rect_dir) and dcos(rect_dir) for callers that have them cached
+	inline bool circle_vs_rotated_rect_sc(float circle_x, float circle_y, float circle_radius, float rect_center_x, float rect_center_y, float rect_w, float rect_h, float rect_sin, float rect_cos) {
 		float dx = circle_x - rect_center_x;
 		float dy = circle_y - rect_center_y;
 
-		float x_rotated = rect_center_x - (dx * dsin(rect_dir)) - (dy * dcos(rect_dir));
-		float y_rotated = rect_center_y + (dx * dcos(rect_dir)) - (dy * dsin(rect_dir));
+		float x_rotated = rect_center_x - (dx * rect_sin) - (dy * rect_cos);
+		float y_rotated = rect_center_y + (dx * rect_cos) - (dy * rect_sin);
 
 		float x_closest = std::clamp(x_rotated, rect_center_x - rect_w / 2.0f, rect_center_x + rect_w / 2.0f);
 		float y_closest = std::clamp(y_rotated, rect_center_y - rect_h / 2.0f, rect_center_y + rect_h / 2.0f);
@@ -92,4 +93,110 @@ namespace cpml {
 		return (sqr(dx) + sqr(dy)) < sqr(circle_radius);
 	}
 
+	inline bool circle_vs_rotated_rect(float circle_x, float circle_y, float circle_radius, float rect_center_x, float rect_center_y, float rect_w, float rect_h, float rect_dir) {
+		return circle_vs_rotated_rect_sc(circle_x, circle_y, circle_radius, rect_center_x, rect_center_y, rect_w, rect_h, dsin(rect_dir), dcos(rect_dir));
+	}
+
+	// Swept tests: the first object moves by (vx, vy) relative to the second
+	// over t in [0, 1]. On contact they return true and write the earliest t.
+
+	// point (x, y) vs circle at (cx, cy)
+	inline bool segment_vs_circle(float x, float y, float vx, float vy, float cx, float cy, float r, float* t) {
+		float px = x - cx;
+		float py = y - cy;
+		float c = sqr(px) + sqr(py) - sqr(r);
+		if (c < 0.0f) {
+			*t = 0.0f;
+			return true;
+		}
+		float a = sqr(vx) + sqr(vy);
+		float b = px * vx + py * vy;
+		if (a == 0.0f || b >= 0.0f) {
+			return false;
+		}
+		float disc = sqr(b) - a * c;
+		if (disc < 0.0f) {
+			return false;
+		}
+		float tt = (-b - sqrtf(disc)) / a;
+		if (tt > 1.0f) {
+			return false;
+		}
+		*t = tt;
+		return true;
+	}
+
+	// point (x, y) vs box |x| <= hx, |y| <= hy
+	inline bool segment_vs_box(float x, float y, float vx, float vy, float hx, float hy, float* t) {
+		float t0 = 0.0f;
+		float t1 = 1.0f;
+		float p[2] = {x, y};
+		float v[2] = {vx, vy};
+		float h[2] = {hx, hy};
+		for (int i = 0; i < 2; i++) {
+			if (v[i] == 0.0f) {
+				if (fabsf(p[i]) > h[i]) return false;
+				continue;
+			}
+			float a = (-h[i] - p[i]) / v[i];
+			float b = ( h[i] - p[i]) / v[i];
+			if (a > b) std::swap(a, b);
+			t0 = std::max(t0, a);
+			t1 = std::min(t1, b);
+			if (t0 > t1) return false;
+		}
+		*t = t0;
+		return true;
+	}
+
+	inline bool swept_circle_vs_circle(float x1, float y1, float r1, float vx, float vy, float x2, float y2, float r2, float* t) {
+		if (circle_vs_circle(x1, y1, r1, x2, y2, r2)) {
+			*t = 0.0f;
+			return true;
+		}
+		return segment_vs_circle(x1, y1, vx, vy, x2, y2, r1 + r2, t);
+	}
+
+	inline bool swept_circle_vs_rotated_rect_sc(float circle_x, float circle_y, float circle_radius, float vx, float vy, float rect_center_x, float rect_center_y, float rect_w, float rect_h, float rect_sin, float rect_cos, float* t) {
+		if (circle_vs_rotated_rect_sc(circle_x, circle_y, circle_radius, rect_center_x, rect_center_y, rect_w, rect_h, rect_sin, rect_cos)) {
+			*t = 0.0f;
+			return true;
+		}
+		if (vx == 0.0f && vy == 0.0f) {
+			return false;
+		}
+
+		// into the rect's frame, same axes as circle_vs_rotated_rect
+		float s = rect_sin;
+		float c = rect_cos;
+		float dx = circle_x - rect_center_x;
+		float dy = circle_y - rect_center_y;
+		float x = -(dx * s) - (dy * c);
+		float y =  (dx * c) - (dy * s);
+		float lvx = -(vx * s) - (vy * c);
+		float lvy =  (vx * c) - (vy * s);
+
+		// the circle's center vs the rect grown by the radius (a rounded rect)
+		float hx = rect_w / 2.0f;
+		float hy = rect_h / 2.0f;
+		float r = circle_radius;
+		float best = 2.0f;
+		float tt;
+		if (segment_vs_box(x, y, lvx, lvy, hx + r, hy, &tt)) best = std::min(best, tt);
+		if (segment_vs_box(x, y, lvx, lvy, hx, hy + r, &tt)) best = std::min(best, tt);
+		if (segment_vs_circle(x, y, lvx, lvy, -hx, -hy, r, &tt)) best = std::min(best, tt);
+		if (segment_vs_circle(x, y, lvx, lvy,  hx, -hy, r, &tt)) best = std::min(best, tt);
+		if (segment_vs_circle(x, y, lvx, lvy, -hx,  hy, r, &tt)) best = std::min(best, tt);
+		if (segment_vs_circle(x, y, lvx, lvy,  hx,  hy, r, &tt)) best = std::min(best, tt);
+		if (best > 1.0f) {
+			return false;
+		}
+		*t = best;
+		return true;
+	}
+
+	inline bool swept_circle_vs_rotated_rect(float circle_x, float circle_y, float circle_radius, float vx, float vy, float rect_center_x, float rect_center_y, float rect_w, float rect_h, float rect_dir, float* t) {
+		return swept_circle_vs_rotated_rect_sc(circle_x, circle_y, circle_radius, vx, vy, rect_center_x, rect_center_y, rect_w, rect_h, dsin(rect_dir), dcos(rect_dir), t);
+	}
+
 }
@@ -23,13 +23,89 @@ static void SpawnConsole() {
 //	return malloc(size);
 //}
 
+static void PrintUsage() {
+	printf(
+		"usage: touhou7 [--console] [--headless] [--stage N] [--frames N] [--seed N] [--kinematics scalar|sse2|avx] [--substep] [--threads N] [--record FILE | --replay FILE] [--trace FILE]\n"
+		"  --headless  run the game scene without window, renderer or audio\n"
+		"  --stage     stage index (test stages start at 100)\n"
+		"  --frames    number of frames to simulate in headless mode\n"
+		"  --seed      seed for the stage and game RNGs\n"
+		"  --kinematics  bullet integration path (default: best supported)\n"
+		"  --substep   legacy physics: 5 fixed substeps per frame instead of swept collision\n"
+		"  --threads   job system threads including the main one (default: cpu count, 1: no workers)\n"
+		"  --record    save the input of the game scene to FILE\n"
+		"  --replay    play FILE back; its stage, character and seeds replace the options above\n"
+		"  --trace     write the profiler's samples to FILE on exit and on F9 (default trace.json)\n"
+	);
+}
+
 extern "C" int main(int argc, char* argv[]) {
-#ifdef TH_RELEASE
-	if (argc == 2) {
-		if (strcmp(argv[1], "--console") == 0) {
-			SpawnConsole();
+	bool console = false;
+	bool headless = false;
+	int headless_frames = 60 * 60;
+	int stage_index = 0;
+	unsigned long seed = 123456789;
+	th::KinematicsPath kinematics = th::KINEMATICS_AVX;
+	bool substep_physics = false;
+	int job_threads = 0;
+	const char* record_path = "";
+	const char* replay_path = "";
+	const char* trace_path = "";
+
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		const char* next = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+		if (strcmp(arg, "--console") == 0) {
+			console = true;
+		} else if (strcmp(arg, "--headless") == 0) {
+			headless = true;
+		} else if (strcmp(arg, "--stage") == 0 && next) {
+			stage_index = atoi(next);
+			i++;
+		} else if (strcmp(arg, "--frames") == 0 && next) {
+			headless_frames = atoi(next);
+			i++;
+		} else if (strcmp(arg, "--seed") == 0 && next) {
+			seed = strtoul(next, nullptr, 10);
+			i++;
+		} else if (strcmp(arg, "--threads") == 0 && next) {
+			job_threads = atoi(next);
+			i++;
+		} else if (strcmp(arg, "--record") == 0 && next) {
+			record_path = next;
+			i++;
+		} else if (strcmp(arg, "--replay") == 0 && next) {
+			replay_path = next;
+			i++;
+		} else if (strcmp(arg, "--trace") == 0 && next) {
+			trace_path = next;
+			i++;
+		} else if (strcmp(arg, "--substep") == 0) {
+			substep_physics = true;
+		} else if (strcmp(arg, "--kinematics") == 0 && next) {
+			int path = th::KINEMATICS_COUNT;
+			for (int j = 0; j < th::KINEMATICS_COUNT; j++) {
+				if (strcmp(next, th::GetKinematicsPathName((th::KinematicsPath)j)) == 0) {
+					path = j;
+				}
+			}
+			if (path == th::KINEMATICS_COUNT) {
+				PrintUsage();
+				return 1;
+			}
+			kinematics = (th::KinematicsPath)path;
+			i++;
+		} else {
+			PrintUsage();
+			return 1;
 		}
 	}
+
+#ifdef TH_RELEASE
+	if (console || headless) {
+		SpawnConsole();
+	}
 #endif
 
 	int result = 0;
@@ -37,6 +113,18 @@ extern "C" int main(int argc, char* argv[]) {
 	for (;;) {
 		th::Game game;
 
+		game.headless = headless;
+		game.headless_frames = headless_frames;
+		game.stage_index = stage_index;
+		game.seed = seed;
+		game.stage_seed = seed;
+		game.kinematics = kinematics;
+		game.substep_physics = substep_physics;
+		game.job_threads = job_threads;
+		game.record_path = record_path;
+		game.replay_path = replay_path;
+		game.trace_path = trace_path;
+
 		if (game.Init()) {
 			if (game.Run()) {
 				result = 0;
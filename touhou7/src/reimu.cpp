@@ -10,9 +10,9 @@ namespace th {
 		result.x = x;
 		result.y = y;
 		result.spd = 16.0f;
-		result.dir = dir;
+		SetDir(result, dir);
 		result.radius = 12.0f;
-		result.sc.sprite = ctx->assets.GetSprite("ReimuCard");
+		result.sc.sprite = ctx->assets.GetSprite(SPR_REIMU_CARD);
 		result.dmg = dmg;
 		result.type = PLAYER_BULLET_REIMU_CARD;
 
@@ -25,9 +25,9 @@ namespace th {
 		result.x = x;
 		result.y = y;
 		result.spd = 12.0f;
-		result.dir = dir;
+		SetDir(result, dir);
 		result.radius = 12.0f;
-		result.sc.sprite = ctx->assets.GetSprite("ReimuOrbShot");
+		result.sc.sprite = ctx->assets.GetSprite(SPR_REIMU_ORB_SHOT);
 		result.dmg = dmg;
 		result.type = PLAYER_BULLET_REIMU_ORB_SHOT;
 
@@ -35,14 +35,12 @@ namespace th {
 	}
 
 	void ReimuShotType(Game* ctx, float delta) {
-		const unsigned char* key = SDL_GetKeyboardState(nullptr);
-
 		Player& player = ctx->game_scene->stage->player;
 
 		player.reimu.fire_timer += delta;
 		while (player.reimu.fire_timer >= 4.0f) {
 			if (player.reimu.fire_queue == 0) {
-				if (key[SDL_SCANCODE_Z]) {
+				if (ctx->input & INPUT_SHOT) {
 					player.reimu.fire_queue = 8;
 				}
 			}
@@ -174,7 +172,7 @@ namespace th {
 					}
 				}
 
-				PlaySound("se_plst00.wav");
+				PlaySound(SND_PLST00);
 				player.reimu.fire_queue--;
 			}
 
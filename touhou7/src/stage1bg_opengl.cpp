@@ -80,7 +80,7 @@ namespace th {
 
 		Stage1_Data* data = (Stage1_Data*)mem;
 
-		data->texture = ctx->assets.GetTexture("MistyLakeTexture.png");
+		data->texture = ctx->assets.GetTexture(TEX_MISTY_LAKE);
 		SDL_SetTextureScaleMode(data->texture, SDL_ScaleModeLinear);
 
 		SDL_RenderFlush(renderer);
@@ -33,7 +33,7 @@ namespace th {
 
 		Stage1_Data* data = (Stage1_Data*)mem;
 
-		SDL_Texture* texture = ctx->assets.GetTexture("MistyLakeTexture.png");
+		SDL_Texture* texture = ctx->assets.GetTexture(TEX_MISTY_LAKE);
 		//SDL_SetTextureScaleMode(texture, SDL_ScaleModeLinear);
 
 		{